@@ -56,6 +56,7 @@
 #include "messages/MCommandReply.h"
 #include "messages/MOSDMap.h"
 #include "messages/MClientQuota.h"
+#include "messages/MClientAuthHint.h"
 #include "messages/MClientCapRelease.h"
 #include "messages/MMDSMap.h"
 #include "messages/MFSMap.h"
@@ -171,7 +172,7 @@ bool Client::CommandHook::call(std::string command, cmdmap_t& cmdmap,
 dir_result_t::dir_result_t(Inode *in, const UserPerm& perms)
   : inode(in), offset(0), next_offset(2),
     release_count(0), ordered_count(0), cache_index(0), start_shared_gen(0),
-    perms(perms)
+    fetch_bytes(0), perms(perms)
   { }
 
 void Client::_reset_faked_inos()
@@ -247,6 +248,8 @@ Client::Client(Messenger *m, MonClient *mc, Objecter *objecter_)
     interrupt_finisher(m->cct),
     remount_finisher(m->cct),
     objecter_finisher(m->cct),
+    async_dirop_next(0), async_dirops_pending(0),
+    prefetch_next(0), prefetches_pending(0),
     tick_event(NULL),
     messenger(m), monclient(mc),
     objecter(objecter_),
@@ -296,6 +299,21 @@ Client::Client(Messenger *m, MonClient *mc, Objecter *objecter_)
 				  true));
   objecter_finisher.start();
   filer.reset(new Filer(objecter, &objecter_finisher));
+
+  if (cct->_conf->client_async_dirops) {
+    for (int i = 0; i < cct->_conf->client_async_dirops_threads; i++) {
+      Finisher *f = new Finisher(cct, "async_dirop", "fn_async_dirop");
+      f->start();
+      async_dirop_finishers.push_back(f);
+    }
+  }
+  if (cct->_conf->client_small_file_prefetch > 0) {
+    for (int i = 0; i < cct->_conf->client_small_file_prefetch_threads; i++) {
+      Finisher *f = new Finisher(cct, "prefetch", "fn_prefetch");
+      f->start();
+      prefetch_finishers.push_back(f);
+    }
+  }
   objecter->enable_blacklist_events();
 }
 
@@ -310,6 +328,11 @@ Client::~Client()
   client_lock.Lock();
   tear_down_cache();
   client_lock.Unlock();
+
+  for (auto f : async_dirop_finishers)
+    delete f;
+  for (auto f : prefetch_finishers)
+    delete f;
 }
 
 void Client::tear_down_cache()
@@ -590,6 +613,15 @@ void Client::shutdown()
   objecter_finisher.wait_for_empty();
   objecter_finisher.stop();
 
+  for (auto f : async_dirop_finishers) {
+    f->wait_for_empty();
+    f->stop();
+  }
+  for (auto f : prefetch_finishers) {
+    f->wait_for_empty();
+    f->stop();
+  }
+
   if (logger) {
     cct->get_perfcounters_collection()->remove(logger.get());
     logger.reset();
@@ -791,6 +823,11 @@ void Client::_fragmap_remove_non_leaves(Inode *in)
       in->fragmap.erase(p++);
     else
       ++p;
+  for (auto p = in->frag_repmap.begin(); p != in->frag_repmap.end(); )
+    if (!in->dirfragtree.is_leaf(p->first))
+      in->frag_repmap.erase(p++);
+    else
+      ++p;
 }
 
 void Client::_fragmap_remove_stopped_mds(Inode *in, mds_rank_t mds)
@@ -800,6 +837,13 @@ void Client::_fragmap_remove_stopped_mds(Inode *in, mds_rank_t mds)
       in->fragmap.erase(p++);
     else
       ++p;
+  for (auto p = in->frag_repmap.begin(); p != in->frag_repmap.end(); ) {
+    p->second.erase(mds);
+    if (p->second.empty())
+      in->frag_repmap.erase(p++);
+    else
+      ++p;
+  }
 }
 
 Inode * Client::add_update_inode(InodeStat *st, utime_t from,
@@ -1026,6 +1070,14 @@ void Client::update_dir_dist(Inode *in, DirStat *dst)
 
   // replicated
   in->dir_replicated = !dst->dist.empty();  // FIXME that's just one frag!
+  if (dst->dist.empty()) {
+    in->frag_repmap.erase(dst->frag);
+  } else {
+    set<mds_rank_t>& reps = in->frag_repmap[dst->frag];
+    reps.clear();
+    for (auto r : dst->dist)
+      reps.insert(mds_rank_t(r));
+  }
   
   // dist
   /*
@@ -1329,7 +1381,10 @@ Inode* Client::insert_trace(MetaRequest *request, MetaSession *session)
 	  unlink(dn, true, true);  // keep dir, dentry
 	}
       }
-      if (dlease.duration_ms > 0) {
+      // keep the null dentry if either its own lease or our Fs cap on
+      // the dir (via cap_shared_gen) lets the next lookup trust it
+      if (dlease.duration_ms > 0 ||
+	  diri->caps_issued_mask(CEPH_CAP_FILE_SHARED, true)) {
 	if (!dn) {
 	  Dir *dir = diri->open_dir();
 	  dn = link(dir, dname, NULL, NULL);
@@ -1453,6 +1508,30 @@ mds_rank_t Client::choose_target_mds(MetaRequest *req, Inode** phash_diri)
     ldout(cct, 20) << "choose_target_mds " << *in << " is_hash=" << is_hash
              << " hash=" << hash << dendl;
   
+    if (cct->_conf->client_replica_reads && req->replica_readable() &&
+	!req->send_to_auth) {
+      if (is_hash && S_ISDIR(in->mode)) {
+	mds = _choose_replica_mds(in, in->dirfragtree[hash]);
+	if (mds >= 0) {
+	  if (phash_diri)
+	    *phash_diri = in;
+	  ldout(cct, 10) << "choose_target_mds from dirfrag replica set" << dendl;
+	  goto out;
+	}
+      } else if (!is_hash && in->snapid == CEPH_NOSNAP && !in->dn_set.empty()) {
+	// a getattr names no dentry; the ranks replicating the dirfrag
+	// of the dentry linking the inode hold a replica of it too
+	Dentry *pdn = in->get_first_parent();
+	Inode *pdiri = pdn->dir->parent_inode;
+	mds = _choose_replica_mds(pdiri,
+				  pdiri->dirfragtree[pdiri->hash_dentry_name(pdn->name)]);
+	if (mds >= 0) {
+	  ldout(cct, 10) << "choose_target_mds from parent dirfrag replica set" << dendl;
+	  goto out;
+	}
+      }
+    }
+
     if (is_hash && S_ISDIR(in->mode) && !in->fragmap.empty()) {
       frag_t fg = in->dirfragtree[hash];
       if (in->fragmap.count(fg)) {
@@ -1488,6 +1567,29 @@ out:
 }
 
 
+/*
+ * Pick one of the ranks holding a replica of dirfrag fg of in.  Each
+ * client sticks to one replica per dirfrag so that its requests stay
+ * ordered, while different clients spread over the whole replica set.
+ */
+mds_rank_t Client::_choose_replica_mds(Inode *in, frag_t fg)
+{
+  auto p = in->frag_repmap.find(fg);
+  if (p == in->frag_repmap.end() || p->second.size() < 2)
+    return MDS_RANK_NONE;
+
+  vector<mds_rank_t> ranks;
+  for (auto r : p->second) {
+    if (mdsmap->is_clientreplay_or_active_or_stopping(r))
+      ranks.push_back(r);
+  }
+  if (ranks.empty())
+    return MDS_RANK_NONE;
+
+  uint64_t seed = get_nodeid().v ^ fg.value();
+  return ranks[seed % ranks.size()];
+}
+
 void Client::connect_mds_targets(mds_rank_t mds)
 {
   ldout(cct, 10) << "connect_mds_targets for mds." << mds << dendl;
@@ -1629,6 +1731,10 @@ int Client::make_request(MetaRequest *request,
 {
   int r = 0;
 
+  // don't overtake dirops that were already acknowledged to the caller
+  if (!request->async_dirop)
+    _wait_async_dirops(request);
+
   // assign a unique tid
   ceph_tid_t tid = ++last_tid;
   request->set_tid(tid);
@@ -1961,6 +2067,9 @@ void Client::populate_metadata(const std::string &mount_root)
   metadata["ceph_version"] = pretty_version_to_str();
   metadata["ceph_sha1"] = git_version_to_str();
 
+  // we understand MClientAuthHint
+  metadata["auth_hints"] = "1";
+
   // Apply any metadata from the user's configured overrides
   std::vector<std::string> tokens;
   get_str_vec(cct->_conf->client_metadata, ",", tokens);
@@ -2140,6 +2249,7 @@ void Client::send_request(MetaRequest *request, MetaSession *session,
   mds_rank_t mds = session->mds_num;
   ldout(cct, 10) << "send_request rebuilding request " << request->get_tid()
 		 << " for mds." << mds << dendl;
+  mds_requests_sent[mds]++;
   MClientRequest *r = build_client_request(request);
   if (request->dentry()) {
     r->set_dentry_wanted();
@@ -2176,6 +2286,9 @@ void Client::send_request(MetaRequest *request, MetaSession *session,
 
   ldout(cct, 10) << "send_request " << *r << " to mds." << mds << dendl;
   session->con->send_message(r);
+
+  if (request->async_unsent)
+    _async_dirop_sent(request);
 }
 
 MClientRequest* Client::build_client_request(MetaRequest *request)
@@ -2496,6 +2609,8 @@ void Client::handle_osd_map(MOSDMap *m)
 bool Client::ms_dispatch(Message *m)
 {
   Mutex::Locker l(client_lock);
+  // anything from an MDS may update inodes or caps
+  invalidate_attr_snapshots();
   if (!initialized) {
     ldout(cct, 10) << "inactive, discarding " << *m << dendl;
     m->put();
@@ -2548,6 +2663,9 @@ bool Client::ms_dispatch(Message *m)
   case CEPH_MSG_CLIENT_QUOTA:
     handle_quota(static_cast<MClientQuota*>(m));
     break;
+  case CEPH_MSG_CLIENT_AUTH_HINT:
+    handle_auth_hint(static_cast<MClientAuthHint*>(m));
+    break;
 
   default:
     return false;
@@ -2910,6 +3028,21 @@ void Client::handle_lease(MClientLease *m)
     dn->lease_mds = -1;
   }
 
+  if (in->async_dirops_unsent > 0) {
+    // an async dirop we queued under this lease must reach the MDS
+    // before the release does, or it could undo what the next holder
+    // does to the name
+    ldout(cct, 10) << " deferring release until " << in->async_dirops_unsent
+		   << " async dirops are sent" << dendl;
+    deferred_lease_acks[in->ino].push_back(
+      make_pair(m->get_connection(),
+		new MClientLease(CEPH_MDS_LEASE_RELEASE, seq, m->get_mask(),
+				 m->get_ino(), m->get_first(), m->get_last(),
+				 m->dname)));
+    m->put();
+    return;
+  }
+
  revoke:
   m->get_connection()->send_message(
     new MClientLease(
@@ -3227,6 +3360,9 @@ int Client::get_caps_used(Inode *in)
   if (!(used & CEPH_CAP_FILE_CACHE) &&
       !objectcacher->set_is_empty(&in->oset))
     used |= CEPH_CAP_FILE_CACHE;
+  // queued async dirops were allowed by Fs; keep it until they are sent
+  if (in->async_dirops_unsent > 0)
+    used |= CEPH_CAP_FILE_SHARED;
   return used;
 }
 
@@ -3952,6 +4088,7 @@ void Client::add_update_cap(Inode *in, MetaSession *mds_session, uint64_t cap_id
 
 void Client::remove_cap(Cap *cap, bool queue_release)
 {
+  invalidate_attr_snapshots();
   Inode *in = cap->inode;
   MetaSession *session = cap->session;
   mds_rank_t mds = cap->session->mds_num;
@@ -4166,6 +4303,8 @@ void Client::mark_caps_dirty(Inode *in, int caps)
 {
   ldout(cct, 10) << "mark_caps_dirty " << *in << " " << ccap_string(in->dirty_caps) << " -> "
 	   << ccap_string(in->dirty_caps | caps) << dendl;
+  // every local attribute change ends up here
+  invalidate_attr_snapshots();
   if (caps && !in->caps_dirty())
     in->get();
   in->dirty_caps |= caps;
@@ -4672,6 +4811,40 @@ void Client::handle_quota(MClientQuota *m)
   m->put();
 }
 
+void Client::handle_auth_hint(MClientAuthHint *m)
+{
+  mds_rank_t mds = mds_rank_t(m->get_source().num());
+  MetaSession *session = _get_mds_session(mds, m->get_connection().get());
+  if (!session) {
+    m->put();
+    return;
+  }
+
+  got_mds_push(session);
+
+  ldout(cct, 10) << "handle_auth_hint " << *m << " from mds." << mds << dendl;
+
+  for (const auto &df : m->dirfrags) {
+    vinodeno_t vino(df.ino, CEPH_NOSNAP);
+    auto p = inode_map.find(vino);
+    if (p == inode_map.end() || !p->second)
+      continue;
+    Inode *in = p->second;
+    // our frag tree may be finer or coarser than the importer's
+    if (in->dirfragtree.is_leaf(df.frag)) {
+      in->fragmap[df.frag] = m->auth;
+    } else {
+      for (auto &q : in->fragmap) {
+	if (df.frag.contains(q.first))
+	  q.second = m->auth;
+      }
+    }
+    ldout(cct, 20) << " " << df << " now on mds." << m->auth << dendl;
+  }
+
+  m->put();
+}
+
 void Client::handle_caps(MClientCaps *m)
 {
   mds_rank_t mds = mds_rank_t(m->get_source().num());
@@ -5872,9 +6045,21 @@ void Client::_unmount()
 
   ldout(cct, 2) << "unmounting" << dendl;
   unmounting = true;
+  // the getattr fast paths never look at 'unmounting'; retire their
+  // snapshots instead (none are saved once unmounting is set)
+  invalidate_attr_snapshots();
 
   deleg_timeout = 0;
 
+  while (async_dirops_pending > 0) {
+    ldout(cct, 10) << "waiting on " << async_dirops_pending << " async dirops" << dendl;
+    mount_cond.Wait(client_lock);
+  }
+  while (prefetches_pending > 0) {
+    ldout(cct, 10) << "waiting on " << prefetches_pending << " prefetches" << dendl;
+    mount_cond.Wait(client_lock);
+  }
+
   flush_mdlog_sync(); // flush the mdlog for pending requests, if any
   while (!mds_requests.empty()) {
     ldout(cct, 10) << "waiting on " << mds_requests.size() << " requests" << dendl;
@@ -6022,6 +6207,7 @@ void Client::tick()
   }
 
   ldout(cct, 21) << "tick" << dendl;
+  invalidate_attr_snapshots();
   tick_event = timer.add_event_after(
     cct->_conf->client_tick_interval,
     new FunctionContext([this](int) {
@@ -6119,7 +6305,7 @@ int Client::_do_lookup(Inode *dir, const string& name, int mask,
 }
 
 int Client::_lookup(Inode *dir, const string& dname, int mask, InodeRef *target,
-		    const UserPerm& perms)
+		    const UserPerm& perms, bool pre_create)
 {
   int r = 0;
   Dentry *dn = NULL;
@@ -6202,6 +6388,24 @@ int Client::_lookup(Inode *dir, const string& dname, int mask, InodeRef *target,
   }
 
   r = _do_lookup(dir, dname, mask, target, perms);
+  if (r == -ENOENT && !pre_create &&
+      cct->_conf->client_negative_lookup_prefetch > 0 &&
+      dir->snapid == CEPH_NOSNAP &&
+      ++dir->enoent_lookups >= (unsigned)cct->_conf->client_negative_lookup_prefetch) {
+    // a run of misses in one dir (include path probing and the like):
+    // fetch the whole thing so the rest are answered locally.  At most
+    // once per Fs generation; a dir that keeps changing under us is not
+    // worth rereading on every few misses.
+    dir->enoent_lookups = 0;
+    if (!(dir->flags & I_COMPLETE) &&
+	dir->enoent_fill_gen != dir->shared_gen &&
+	dir->caps_issued_mask(CEPH_CAP_FILE_SHARED, true) &&
+	dir->dirstat.size() <= cct->_conf->client_negative_lookup_prefetch_max_entries) {
+      InodeRef hold(dir);
+      _readdir_fill_complete(dir, perms);
+      dir->enoent_fill_gen = dir->shared_gen;
+    }
+  }
   goto done;
 
  hit_dn:
@@ -6220,6 +6424,17 @@ int Client::_lookup(Inode *dir, const string& dname, int mask, InodeRef *target,
   return r;
 }
 
+/*
+ * A successful create in dir: the miss that checked the name first
+ * (FUSE's LOOKUP before CREATE/MKNOD/MKDIR, or open(O_CREAT)'s
+ * path_walk) was expected, not a sign of probing.
+ */
+void Client::_forgive_enoent_lookup(Inode *dir)
+{
+  if (dir->enoent_lookups > 0)
+    dir->enoent_lookups--;
+}
+
 int Client::get_or_create(Inode *dir, const char* name,
 			  Dentry **pdn, bool expect_null)
 {
@@ -7651,6 +7866,7 @@ int Client::_readdir_get_frag(dir_result_t *dirp)
   req->set_inode(diri.get());
   req->head.args.readdir.frag = fg;
   req->head.args.readdir.flags = CEPH_READDIR_REPLY_BITFLAGS;
+  req->head.args.readdir.max_bytes = dirp->fetch_bytes;
   if (dirp->last_name.length()) {
     req->path2.set_path(dirp->last_name);
   } else if (dirp->hash_order()) {
@@ -7670,6 +7886,12 @@ int Client::_readdir_get_frag(dir_result_t *dirp)
   if (res == 0) {
     ldout(cct, 10) << "_readdir_get_frag " << dirp << " got frag " << dirp->buffer_frag
 		   << " size " << dirp->buffer.size() << dendl;
+    // a caller that keeps reading is scanning the whole directory; ask
+    // for bigger chunks so a huge directory costs fewer round trips
+    uint64_t max_bytes = cct->_conf->client_readdir_max_bytes;
+    if (max_bytes && !dirp->at_end())
+      dirp->fetch_bytes = MIN(MAX(2 * (uint64_t)dirp->fetch_bytes, (uint64_t)1 << 20),
+			      max_bytes);
   } else {
     ldout(cct, 10) << "_readdir_get_frag got error " << res << ", setting end flag" << dendl;
     dirp->set_end();
@@ -7678,6 +7900,67 @@ int Client::_readdir_get_frag(dir_result_t *dirp)
   return res;
 }
 
+/*
+ * dirp has just read the last frag.  if nothing changed the dir
+ * behind its back, our dentries are the complete contents.
+ */
+void Client::_readdir_mark_complete(dir_result_t *dirp)
+{
+  InodeRef& diri = dirp->inode;
+
+  if (diri->shared_gen == dirp->start_shared_gen &&
+      diri->dir_release_count == dirp->release_count) {
+    if (diri->dir_ordered_count == dirp->ordered_count) {
+      ldout(cct, 10) << " marking (I_COMPLETE|I_DIR_ORDERED) on " << *diri << dendl;
+      if (diri->dir) {
+	assert(diri->dir->readdir_cache.size() >= dirp->cache_index);
+	diri->dir->readdir_cache.resize(dirp->cache_index);
+      }
+      diri->flags |= I_COMPLETE | I_DIR_ORDERED;
+    } else {
+      ldout(cct, 10) << " marking I_COMPLETE on " << *diri << dendl;
+      diri->flags |= I_COMPLETE;
+    }
+  }
+}
+
+/*
+ * Read all of dir into the dentry cache, without handing anything to
+ * a caller.  Each readdir reply carries a lease for every dentry in
+ * the chunk, and once the last frag is in, our Fs cap makes the dir
+ * complete, so later lookup misses in it need no MDS round trip.
+ */
+int Client::_readdir_fill_complete(Inode *dir, const UserPerm& perms)
+{
+  dir_result_t *dirp;
+  int r = _opendir(dir, &dirp, perms);
+  if (r < 0)
+    return r;
+
+  ldout(cct, 10) << __func__ << " " << *dir << dendl;
+  dirp->offset = 2;  // no . and ..
+  while (1) {
+    r = _readdir_get_frag(dirp);
+    if (r < 0)
+      break;
+    if (!dirp->buffer.empty())
+      dirp->offset = dirp->buffer.back().offset + 1;
+
+    if (dirp->next_offset > 2) {
+      _readdir_drop_dirp_buffer(dirp);
+      continue;
+    }
+    if (!dirp->buffer_frag.is_rightmost()) {
+      _readdir_next_frag(dirp);
+      continue;
+    }
+    _readdir_mark_complete(dirp);
+    break;
+  }
+  _closedir(dirp);
+  return r;
+}
+
 struct dentry_off_lt {
   bool operator()(const Dentry* dn, int64_t off) const {
     return dir_result_t::fpos_cmp(dn->offset, off) < 0;
@@ -7721,6 +8004,18 @@ int Client::_readdir_cache_cb(dir_result_t *dirp, add_dirent_cb_t cb, void *p,
       continue;
     }
 
+    if (caps && !dn->inode->caps_issued_mask(caps, true)) {
+      // one readdir from the mds brings back attrs and caps for this
+      // entry and the ones after it, where getattr costs a round trip
+      // per entry
+      ldout(cct, 15) << " no caps on '" << dn->name << "', reading from mds" << dendl;
+      // the dir is still complete and ordered, but this dirp's
+      // cache_index was never advanced here; keep the mds reply from
+      // refilling readdir_cache at a stale index
+      dirp->ordered_count = 0;
+      return -EAGAIN;
+    }
+
     int r = _getattr(dn->inode, caps, dirp->perms);
     if (r < 0)
       return r;
@@ -7945,20 +8240,7 @@ int Client::readdir_r_cb(dir_result_t *d, add_dirent_cb_t cb, void *p,
       continue;
     }
 
-    if (diri->shared_gen == dirp->start_shared_gen &&
-	diri->dir_release_count == dirp->release_count) {
-      if (diri->dir_ordered_count == dirp->ordered_count) {
-	ldout(cct, 10) << " marking (I_COMPLETE|I_DIR_ORDERED) on " << *diri << dendl;
-	if (diri->dir) {
-	  assert(diri->dir->readdir_cache.size() >= dirp->cache_index);
-	  diri->dir->readdir_cache.resize(dirp->cache_index);
-	}
-	diri->flags |= I_COMPLETE | I_DIR_ORDERED;
-      } else {
-	ldout(cct, 10) << " marking I_COMPLETE on " << *diri << dendl;
-	diri->flags |= I_COMPLETE;
-      }
-    }
+    _readdir_mark_complete(dirp);
 
     dirp->set_end();
     return 0;
@@ -8228,6 +8510,8 @@ int Client::open(const char *relpath, int flags, const UserPerm& perms,
     r = get_fd();
     assert(fd_map.count(r) == 0);
     fd_map[r] = fh;
+    if ((flags & O_ACCMODE) == O_RDONLY)
+      _prefetch_siblings(in.get(), perms);
   }
   
  out:
@@ -8898,6 +9182,105 @@ done:
     return bl->length();
 }
 
+class C_Client_Prefetch : public Context {
+private:
+  Client *client;
+  Inode *in;
+  UserPerm perms;
+public:
+  C_Client_Prefetch(Client *c, Inode *i, const UserPerm& p)
+    : client(c), in(i), perms(p) {}
+  void finish(int r) override {
+    Mutex::Locker l(client->client_lock);
+    client->_prefetch_small_file(in, perms);
+  }
+};
+
+/*
+ * in was just opened read-only.  If it follows the previous such open
+ * in its directory's readdir order, we are probably looking at a scan
+ * over many small files (one open/read/close each); open and read the
+ * next few in the background so that their caps and data are already
+ * here when the scan reaches them.
+ */
+void Client::_prefetch_siblings(Inode *in, const UserPerm& perms)
+{
+  if (prefetch_finishers.empty() || !in->is_file() || in->dn_set.empty())
+    return;
+
+  Dentry *dn = in->get_first_parent();
+  Dir *dir = dn->dir;
+  Inode *diri = dir->parent_inode;
+  if (!diri->is_complete_and_ordered() ||
+      !diri->caps_issued_mask(CEPH_CAP_FILE_SHARED, true))
+    return;
+
+  vector<Dentry*>::iterator pd = std::lower_bound(dir->readdir_cache.begin(),
+						  dir->readdir_cache.end(),
+						  dn->offset, dentry_off_lt());
+  if (pd == dir->readdir_cache.end() || *pd != dn)
+    return;
+
+  // allow a few entries (subdirs, files the scan skips) in between
+  vector<Dentry*>::iterator pp = std::lower_bound(dir->readdir_cache.begin(), pd,
+						  diri->scan_last_off, dentry_off_lt());
+  if (diri->scan_run > 0 && pp != pd && (*pp)->offset == diri->scan_last_off &&
+      pd - pp <= 4) {
+    diri->scan_run++;
+  } else {
+    diri->scan_run = 1;
+    diri->scan_prefetch_off = dn->offset;
+  }
+  diri->scan_last_off = dn->offset;
+  if (diri->scan_run < 2)
+    return;
+
+  uint64_t max_size = cct->_conf->client_small_file_prefetch_max_size;
+  int n = cct->_conf->client_small_file_prefetch;
+  for (++pd; pd != dir->readdir_cache.end() && n > 0; ++pd, --n) {
+    Dentry *next = *pd;
+    if (dir_result_t::fpos_cmp(next->offset, diri->scan_prefetch_off) <= 0)
+      continue;  // queued by an earlier open
+    diri->scan_prefetch_off = next->offset;
+
+    Inode *nin = next->inode.get();
+    if (!nin || !nin->is_file() || next->cap_shared_gen != diri->shared_gen ||
+	nin->size == 0 || nin->size > max_size ||
+	!objectcacher->set_is_empty(&nin->oset))
+      continue;
+
+    ldout(cct, 10) << __func__ << " prefetching '" << next->name << "' "
+		   << *nin << dendl;
+    nin->get();
+    prefetches_pending++;
+    Finisher *f = prefetch_finishers[prefetch_next++ %
+				     prefetch_finishers.size()];
+    f->queue(new C_Client_Prefetch(this, nin, perms));
+  }
+}
+
+void Client::_prefetch_small_file(Inode *in, const UserPerm& perms)
+{
+  // opening takes the caps the application's open would need, and with
+  // Fc held the read leaves the first object in the object cache
+  if (!unmounting && in->size > 0 &&
+      objectcacher->set_is_empty(&in->oset) &&
+      (!cct->_conf->client_permissions || may_open(in, O_RDONLY, perms) == 0)) {
+    Fh *f;
+    int r = _open(in, O_RDONLY, 0, &f, perms);
+    if (r == 0) {
+      bufferlist bl;
+      r = _read(f, 0, MIN(in->size, (uint64_t)in->layout.object_size), &bl);
+      _release_fh(f);
+    }
+    ldout(cct, 10) << __func__ << " " << *in << " = " << r << dendl;
+  }
+
+  put_inode(in);
+  if (--prefetches_pending == 0 && unmounting)
+    mount_cond.Signal();
+}
+
 Client::C_Readahead::C_Readahead(Client *c, Fh *f) :
     client(c), f(f) {
   f->get();
@@ -9530,6 +9913,12 @@ int Client::_fsync(Inode *in, bool syncdataonly)
 int Client::_fsync(Fh *f, bool syncdataonly)
 {
   ldout(cct, 3) << "_fsync(" << f << ", " << (syncdataonly ? "dataonly)":"data+metadata)") << dendl;
+  if (f->inode->is_dir()) {
+    // report async dirops that failed after we already returned success
+    int r = _flush_async_dirops(f->inode.get());
+    int r2 = _fsync(f->inode.get(), syncdataonly);
+    return r < 0 ? r : r2;
+  }
   return _fsync(f->inode.get(), syncdataonly);
 }
 
@@ -10282,6 +10671,12 @@ int Client::get_caps_issued(const char *path, const UserPerm& perms)
   return in->caps_issued();
 }
 
+void Client::get_mds_request_counts(map<mds_rank_t, uint64_t> *counts)
+{
+  Mutex::Locker lock(client_lock);
+  *counts = mds_requests_sent;
+}
+
 // =========================================
 // low level
 
@@ -10569,8 +10964,86 @@ int Client::_ll_getattr(Inode *in, int caps, const UserPerm& perms)
     return _getattr(in, caps, perms);
 }
 
+/*
+ * Called with client_lock held, right after filling st/stx for an inode
+ * whose caps cover 'mask'.
+ */
+void Client::save_attr_snapshot(Inode *in, unsigned mask, const struct stat *st,
+				const struct ceph_statx *stx)
+{
+  if (!cct->_conf->client_lockless_getattr || in->snapid != CEPH_NOSNAP)
+    return;
+  if (!mask || (in->snap_caps & mask) || !in->caps_issued_mask(mask, true))
+    return;
+
+  // the snapshot is only as good as the caps it was served from
+  utime_t valid_until;
+  for (auto &p : in->caps) {
+    if (!in->cap_is_valid(p.second))
+      continue;
+    utime_t ttl = p.second->session->cap_ttl;
+    if (valid_until == utime_t() || ttl < valid_until)
+      valid_until = ttl;
+  }
+  if (valid_until == utime_t())
+    return;
+
+  std::lock_guard<std::mutex> l(in->attr_snap_lock);
+  Inode::attr_snapshot_t &s = in->attr_snap;
+  if (s.epoch != attr_epoch) {
+    s.mask = 0;
+    s.have_stat = false;
+  }
+  s.epoch = attr_epoch;
+  s.valid_until = valid_until;
+  if (st) {
+    s.st = *st;
+    s.have_stat = true;
+  }
+  if (stx) {
+    s.stx = *stx;
+    s.mask = mask;
+  }
+}
+
+/*
+ * Lock-free: may be called without client_lock, as long as the caller
+ * holds an ll reference on the inode.  _unmount bumps attr_epoch, so a
+ * hit here also means we were still mounted when the snapshot was read.
+ */
+bool Client::get_attr_snapshot(Inode *in, unsigned mask, struct stat *st,
+			       struct ceph_statx *stx)
+{
+  if (!cct->_conf->client_lockless_getattr)
+    return false;
+
+  std::lock_guard<std::mutex> l(in->attr_snap_lock);
+  const Inode::attr_snapshot_t &s = in->attr_snap;
+  if (s.epoch != attr_epoch || ceph_clock_now() >= s.valid_until)
+    return false;
+  if (st) {
+    if (!s.have_stat)
+      return false;
+    *st = s.st;
+  }
+  if (stx) {
+    if ((s.mask & mask) != mask)
+      return false;
+    *stx = s.stx;
+  }
+  return true;
+}
+
 int Client::ll_getattr(Inode *in, struct stat *attr, const UserPerm& perms)
 {
+#ifndef TRACE_COLLECTION
+  // traced runs must see every getattr, so they always take the lock
+  if (get_attr_snapshot(in, 0, attr, NULL)) {
+    ldout(cct, 10) << "ll_getattr " << in->vino() << " from snapshot" << dendl;
+    return 0;
+  }
+#endif
+
   Mutex::Locker lock(client_lock);
 
   if (unmounting)
@@ -10578,8 +11051,10 @@ int Client::ll_getattr(Inode *in, struct stat *attr, const UserPerm& perms)
 
   int res = _ll_getattr(in, CEPH_STAT_CAP_INODE_ALL, perms);
 
-  if (res == 0)
+  if (res == 0) {
     fill_stat(in, attr);
+    save_attr_snapshot(in, CEPH_STAT_CAP_INODE_ALL, attr, NULL);
+  }
   ldout(cct, 3) << "ll_getattr " << _get_vino(in) << " = " << res << dendl;
   #ifdef TRACE_COLLECTION
   if(in != NULL){
@@ -10594,19 +11069,29 @@ int Client::ll_getattr(Inode *in, struct stat *attr, const UserPerm& perms)
 int Client::ll_getattrx(Inode *in, struct ceph_statx *stx, unsigned int want,
 			unsigned int flags, const UserPerm& perms)
 {
+  unsigned mask = statx_to_mask(flags, want);
+
+#ifndef TRACE_COLLECTION
+  if (mask && get_attr_snapshot(in, mask, NULL, stx)) {
+    ldout(cct, 10) << "ll_getattrx " << in->vino() << " from snapshot" << dendl;
+    return 0;
+  }
+#endif
+
   Mutex::Locker lock(client_lock);
 
   if (unmounting)
     return -ENOTCONN;
 
   int res = 0;
-  unsigned mask = statx_to_mask(flags, want);
 
   if (mask && !in->caps_issued_mask(mask, true))
     res = _ll_getattr(in, mask, perms);
 
-  if (res == 0)
+  if (res == 0) {
     fill_statx(in, mask, stx);
+    save_attr_snapshot(in, mask, NULL, stx);
+  }
   ldout(cct, 3) << "ll_getattrx " << _get_vino(in) << " = " << res << dendl;
   return res;
 }
@@ -11053,6 +11538,12 @@ int Client::_do_setxattr(Inode *in, const char *name, const void *value,
   if (flags & XATTR_REPLACE)
     xattr_flags |= CEPH_XATTR_REPLACE;
 
+  if (cct->_conf->client_buffered_xattrs) {
+    int r = _setxattr_buffered(in, name, value, size, xattr_flags, perms);
+    if (r != -EAGAIN)
+      return r;
+  }
+
   MetaRequest *req = new MetaRequest(CEPH_MDS_OP_SETXATTR);
   filepath path;
   in->make_nosnap_relative_path(path);
@@ -11073,6 +11564,65 @@ int Client::_do_setxattr(Inode *in, const char *name, const void *value,
   return res;
 }
 
+/*
+ * Apply a setxattr to our copy of the xattrs while we hold Xx, and let
+ * the next cap flush carry it to the MDS along with whatever else is
+ * dirty: a freshly created file typically gets create, chown/utimes
+ * and a few user xattrs, which then cost one cap message and one
+ * journal event instead of a request each.  Returns -EAGAIN when the
+ * update has to go to the MDS.
+ */
+int Client::_setxattr_buffered(Inode *in, const char *name, const void *value,
+			       size_t size, int xattr_flags,
+			       const UserPerm& perms)
+{
+  if (strncmp(name, "user.", 5) &&
+      strncmp(name, "security.", 9) &&
+      strncmp(name, "trusted.", 8))
+    return -EAGAIN;
+  if (in->xattr_version == 0 ||
+      !in->caps_issued_mask(CEPH_CAP_XATTR_EXCL))
+    return -EAGAIN;
+
+  string n(name);
+  auto p = in->xattrs.find(n);
+  if ((xattr_flags & CEPH_XATTR_CREATE) && p != in->xattrs.end())
+    return -EEXIST;
+  if ((xattr_flags & CEPH_XATTR_REPLACE) && p == in->xattrs.end())
+    return -ENODATA;
+
+  if (!(xattr_flags & CEPH_XATTR_REMOVE)) {
+    // same sum the MDS checks on a setxattr request: the old value of
+    // the key still counts unless XATTR_REPLACE was given.  Past the
+    // limit, let the MDS answer.
+    size_t total = n.length() + size;
+    for (const auto &q : in->xattrs) {
+      if ((xattr_flags & CEPH_XATTR_REPLACE) && q.first == n)
+	continue;
+      total += q.first.length() + q.second.length();
+    }
+    if (total > cct->_conf->mds_max_xattr_pairs_size)
+      return -EAGAIN;
+  }
+
+  if (xattr_flags & CEPH_XATTR_REMOVE) {
+    if (p != in->xattrs.end())
+      in->xattrs.erase(p);
+  } else {
+    in->xattrs[n] = buffer::copy((const char*)value, size);
+  }
+  in->xattr_version++;
+  in->ctime = ceph_clock_now();
+  in->change_attr++;
+  in->cap_dirtier_uid = perms.uid();
+  in->cap_dirtier_gid = perms.gid();
+  mark_caps_dirty(in, CEPH_CAP_XATTR_EXCL);
+
+  ldout(cct, 10) << __func__ << " " << *in << " '" << name << "' buffered, xattr_version "
+		 << in->xattr_version << dendl;
+  return 0;
+}
+
 int Client::_setxattr(Inode *in, const char *name, const void *value,
 		      size_t size, int flags, const UserPerm& perms)
 {
@@ -11595,6 +12145,8 @@ int Client::_mknod(Inode *dir, const char *name, mode_t mode, dev_t rdev,
   req->set_dentry(de);
 
   res = make_request(req, perms, inp);
+  if (res == 0)
+    _forgive_enoent_lookup(dir);
 
   trim_cache();
 
@@ -11760,6 +12312,7 @@ int Client::_create(Inode *dir, const char *name, int flags, mode_t mode,
   if (res < 0) {
     goto reply_error;
   }
+  _forgive_enoent_lookup(dir);
 
   /* If the caller passed a value in fhp, do the open */
   if(fhp) {
@@ -11828,6 +12381,8 @@ int Client::_mkdir(Inode *dir, const char *name, mode_t mode, const UserPerm& pe
   ldout(cct, 10) << "_mkdir: making request" << dendl;
   res = make_request(req, perm, inp);
   ldout(cct, 10) << "_mkdir result is " << res << dendl;
+  if (res == 0)
+    _forgive_enoent_lookup(dir);
 
   trim_cache();
 
@@ -11955,6 +12510,8 @@ int Client::_symlink(Inode *dir, const char *name, const char *target,
   req->set_dentry(de);
 
   res = make_request(req, perms, inp);
+  if (res == 0)
+    _forgive_enoent_lookup(dir);
 
   trim_cache();
   ldout(cct, 3) << "_symlink(\"" << path << "\", \"" << target << "\") = " <<
@@ -12085,6 +12642,20 @@ int Client::_unlink(Inode *dir, const char *name, const UserPerm& perm)
 
   req->set_inode(dir);
 
+  if (_can_async_unlink(dir, de, in)) {
+    // the lease says the dentry is there and nobody else can change it
+    // without telling us first; drop it now and let a worker carry the
+    // request
+    unlink(de, true, true);
+    // mirror what the reply would tell us about the target
+    if (in->nlink > 0)
+      in->nlink--;
+    invalidate_attr_snapshots();
+    _submit_async_dirop(req, perm);
+    ldout(cct, 3) << "unlink(" << path << ") = 0 (async)" << dendl;
+    return 0;
+  }
+
   res = make_request(req, perm);
 
   trim_cache();
@@ -12096,6 +12667,139 @@ int Client::_unlink(Inode *dir, const char *name, const UserPerm& perm)
   return res;
 }
 
+bool Client::_can_async_unlink(Inode *dir, Dentry *dn, Inode *in)
+{
+  if (async_dirop_finishers.empty() || !cct->_conf->client_async_dirops)
+    return false;
+  if (in->is_dir() || dn->inode != in)
+    return false;
+
+  utime_t now = ceph_clock_now();
+  if (dn->lease_mds >= 0 &&
+      dn->lease_ttl > now &&
+      mds_sessions.count(dn->lease_mds)) {
+    MetaSession *s = mds_sessions[dn->lease_mds];
+    if (s->cap_ttl > now && s->cap_gen == dn->lease_gen)
+      return true;
+  }
+  return dir->caps_issued_mask(CEPH_CAP_FILE_SHARED, true) &&
+	 dn->cap_shared_gen == dir->shared_gen;
+}
+
+class C_Client_AsyncDirop : public Context {
+private:
+  Client *client;
+  MetaRequest *req;
+  UserPerm perms;
+public:
+  C_Client_AsyncDirop(Client *c, MetaRequest *r, const UserPerm& p)
+    : client(c), req(r), perms(p) {}
+  void finish(int r) override {
+    Mutex::Locker l(client->client_lock);
+    client->_finish_async_dirop(req, perms);
+  }
+};
+
+void Client::_submit_async_dirop(MetaRequest *req, const UserPerm& perm)
+{
+  req->async_dirop = true;
+  req->async_unsent = true;
+  req->inode()->async_dirops++;
+  req->inode()->async_dirops_unsent++;
+  if (req->other_inode())
+    req->other_inode()->async_dirops++;
+  async_dirops_pending++;
+
+  Finisher *f = async_dirop_finishers[async_dirop_next++ %
+				      async_dirop_finishers.size()];
+  f->queue(new C_Client_AsyncDirop(this, req, perm));
+}
+
+void Client::_finish_async_dirop(MetaRequest *req, const UserPerm& perm)
+{
+  int op = req->get_op();
+  InodeRef dir = req->inode();
+  InodeRef other = req->other_inode();
+
+  req->get();  // make_request drops the caller's ref
+  int r = make_request(req, perm);
+  ldout(cct, 10) << __func__ << " " << ceph_mds_op_name(op) << " in "
+		 << dir->ino << " = " << r << dendl;
+  if (req->async_unsent)  // failed before it was ever sent
+    _async_dirop_sent(req);
+  put_request(req);
+  if (r < 0) {
+    lderr(cct) << "async " << ceph_mds_op_name(op) << " in " << *dir
+	       << " failed: " << cpp_strerror(r) << dendl;
+    async_dirop_errs.insert(make_pair(dir->ino, r));
+    // we already told the caller otherwise; make sure the cache does not
+    // keep answering from the local result
+    dir->shared_gen++;
+    clear_dir_complete_and_ordered(dir.get(), true);
+    if (op == CEPH_MDS_OP_UNLINK && other)
+      other->nlink++;
+    invalidate_attr_snapshots();
+  }
+  trim_cache();
+
+  if (--dir->async_dirops == 0)
+    signal_cond_list(dir->waitfor_async_dirops);
+  if (other && --other->async_dirops == 0)
+    signal_cond_list(other->waitfor_async_dirops);
+  if (--async_dirops_pending == 0 && unmounting)
+    mount_cond.Signal();
+}
+
+/*
+ * The request is on the wire (or will never be): revokes of what
+ * allowed it can be acked now, since they will reach the MDS after it.
+ */
+void Client::_async_dirop_sent(MetaRequest *req)
+{
+  req->async_unsent = false;
+  Inode *dir = req->inode();
+  if (--dir->async_dirops_unsent > 0)
+    return;
+
+  auto p = deferred_lease_acks.find(dir->ino);
+  if (p != deferred_lease_acks.end()) {
+    for (auto &q : p->second)
+      q.first->send_message(q.second);
+    deferred_lease_acks.erase(p);
+  }
+  check_caps(dir, 0);
+}
+
+void Client::_wait_async_dirops(MetaRequest *req)
+{
+  while (true) {
+    Inode *busy = NULL;
+    for (Inode *in : { req->inode(), req->old_inode(), req->other_inode() }) {
+      if (in && in->async_dirops > 0) {
+	busy = in;
+	break;
+      }
+    }
+    if (!busy)
+      break;
+    ldout(cct, 10) << __func__ << " waiting on " << busy->async_dirops
+		   << " async dirops on " << *busy << dendl;
+    wait_on_list(busy->waitfor_async_dirops);
+  }
+}
+
+int Client::_flush_async_dirops(Inode *dir)
+{
+  while (dir->async_dirops > 0)
+    wait_on_list(dir->waitfor_async_dirops);
+  auto p = async_dirop_errs.find(dir->ino);
+  if (p == async_dirop_errs.end())
+    return 0;
+  int r = p->second;
+  async_dirop_errs.erase(p);
+  return r;
+}
+
 int Client::ll_unlink(Inode *in, const char *name, const UserPerm& perm)
 {
   Mutex::Locker lock(client_lock);
@@ -12616,7 +13320,9 @@ int Client::ll_fsyncdir(dir_result_t *dirp)
   if (unmounting)
     return -ENOTCONN;
 
-  return _fsync(dirp->inode.get(), false);
+  int r = _flush_async_dirops(dirp->inode.get());
+  int r2 = _fsync(dirp->inode.get(), false);
+  return r < 0 ? r : r2;
 }
 
 int Client::ll_open(Inode *in, int flags, Fh **fhp, const UserPerm& perms)
@@ -12643,6 +13349,8 @@ int Client::ll_open(Inode *in, int flags, Fh **fhp, const UserPerm& perms)
   }
 
   r = _open(in, flags, 0, fhp /* may be NULL */, perms);
+  if (r == 0 && (flags & O_ACCMODE) == O_RDONLY)
+    _prefetch_siblings(in, perms);
 
  out:
   Fh *fhptr = fhp ? *fhp : NULL;
@@ -12683,7 +13391,7 @@ int Client::_ll_create(Inode *parent, const char *name, mode_t mode,
   tout(cct) << ceph_flags_sys2wire(flags) << std::endl;
 
   bool created = false;
-  int r = _lookup(parent, name, caps, in, perms);
+  int r = _lookup(parent, name, caps, in, perms, flags & O_CREAT);
 
   if (r == 0 && (flags & O_CREAT) && (flags & O_EXCL))
     return -EEXIST;
@@ -13627,6 +14335,7 @@ void Client::ms_handle_remote_reset(Connection *con)
 {
   ldout(cct, 0) << "ms_handle_remote_reset on " << con->get_peer_addr() << dendl;
   Mutex::Locker l(client_lock);
+  invalidate_attr_snapshots();
   switch (con->get_peer_type()) {
   case CEPH_ENTITY_TYPE_MDS:
     {
@@ -201,6 +201,7 @@ struct dir_result_t {
   uint64_t ordered_count;
   unsigned cache_index;
   int start_shared_gen;  // dir shared_gen at start of readdir
+  unsigned fetch_bytes;  // max_bytes for the next chunk (0: mds default)
   UserPerm perms;
 
   frag_t buffer_frag;
@@ -247,6 +248,7 @@ struct dir_result_t {
     offset = 0;
     ordered_count = 0;
     cache_index = 0;
+    fetch_bytes = 0;
     buffer.clear();
   }
 };
@@ -286,6 +288,24 @@ class Client : public Dispatcher, public md_config_obs_t {
   Finisher remount_finisher;
   Finisher objecter_finisher;
 
+  // workers carrying asynchronous dirops to the MDS; each one keeps a
+  // single request in flight, so their number bounds the pipeline depth
+  vector<Finisher*> async_dirop_finishers;
+  unsigned async_dirop_next;
+  int async_dirops_pending;
+  // first error an async dirop came back with, by parent directory; kept
+  // here rather than in the Inode so it survives the dir being trimmed
+  // before the next fsync on it
+  map<inodeno_t, int> async_dirop_errs;
+  // dentry lease releases held back until the dir's queued async dirops
+  // are on the wire ahead of them
+  map<inodeno_t, list<pair<ConnectionRef, Message*> > > deferred_lease_acks;
+
+  // workers opening and reading files ahead of a readdir-order scan
+  vector<Finisher*> prefetch_finishers;
+  unsigned prefetch_next;
+  int prefetches_pending;
+
   Context *tick_event;
   utime_t last_cap_renew;
   void renew_caps();
@@ -320,6 +340,7 @@ protected:
 
   // mds sessions
   map<mds_rank_t, MetaSession*> mds_sessions;  // mds -> push seq
+  map<mds_rank_t, uint64_t> mds_requests_sent;  // for benchmarks
   list<Cond*> waiting_for_mdsmap;
 
   // FSMap, for when using mds_command
@@ -377,6 +398,7 @@ protected:
   void encode_dentry_release(Dentry *dn, MetaRequest *req,
 			     mds_rank_t mds, int drop, int unless);
   mds_rank_t choose_target_mds(MetaRequest *req, Inode** phash_diri=NULL);
+  mds_rank_t _choose_replica_mds(Inode *in, frag_t fg);
   void connect_mds_targets(mds_rank_t mds);
   void send_request(MetaRequest *request, MetaSession *session,
 		    bool drop_cap_releases=false);
@@ -502,6 +524,8 @@ protected:
   friend class C_Client_FlushComplete; // calls put_inode()
   friend class C_Client_CacheInvalidate;  // calls ino_invalidate_cb
   friend class C_Client_DentryInvalidate;  // calls dentry_invalidate_cb
+  friend class C_Client_AsyncDirop;  // calls _finish_async_dirop
+  friend class C_Client_Prefetch;  // calls _prefetch_small_file
   friend class C_Block_Sync; // Calls block map and protected helpers
   friend class C_Client_RequestInterrupt;
   friend class C_Client_Remount;
@@ -529,6 +553,15 @@ protected:
   }
 
   void fill_statx(Inode *in, unsigned int mask, struct ceph_statx *stx);
+
+  // Bumped (under client_lock) whenever inode attributes or caps may have
+  // changed; invalidates every Inode::attr_snap at once.
+  std::atomic<uint64_t> attr_epoch{1};
+  void invalidate_attr_snapshots() { ++attr_epoch; }
+  void save_attr_snapshot(Inode *in, unsigned mask, const struct stat *st,
+			  const struct ceph_statx *stx);
+  bool get_attr_snapshot(Inode *in, unsigned mask, struct stat *st,
+			 struct ceph_statx *stx);
   void fill_statx(InodeRef& in, unsigned int mask, struct ceph_statx *stx) {
     return fill_statx(in.get(), mask, stx);
   }
@@ -650,6 +683,7 @@ protected:
 			      vector<snapid_t>& snaps);
 
   void handle_quota(struct MClientQuota *m);
+  void handle_auth_hint(struct MClientAuthHint *m);
   void handle_snap(struct MClientSnap *m);
   void handle_caps(class MClientCaps *m);
   void handle_cap_import(MetaSession *session, Inode *in, class MClientCaps *m);
@@ -749,6 +783,8 @@ private:
   void _readdir_next_frag(dir_result_t *dirp);
   void _readdir_rechoose_frag(dir_result_t *dirp);
   int _readdir_get_frag(dir_result_t *dirp);
+  void _readdir_mark_complete(dir_result_t *dirp);
+  int _readdir_fill_complete(Inode *dir, const UserPerm& perms);
   int _readdir_cache_cb(dir_result_t *dirp, add_dirent_cb_t cb, void *p, int caps, bool getref);
   void _closedir(dir_result_t *dirp);
 
@@ -784,11 +820,18 @@ private:
 		 const UserPerm& perms);
 
   int _lookup(Inode *dir, const string& dname, int mask, InodeRef *target,
-	      const UserPerm& perm);
+	      const UserPerm& perm, bool pre_create=false);
+  void _forgive_enoent_lookup(Inode *dir);
 
   int _link(Inode *in, Inode *dir, const char *name, const UserPerm& perm,
 	    InodeRef *inp = 0);
   int _unlink(Inode *dir, const char *name, const UserPerm& perm);
+  bool _can_async_unlink(Inode *dir, Dentry *dn, Inode *in);
+  void _submit_async_dirop(MetaRequest *req, const UserPerm& perm);
+  void _finish_async_dirop(MetaRequest *req, const UserPerm& perm);
+  void _async_dirop_sent(MetaRequest *req);
+  void _wait_async_dirops(MetaRequest *req);
+  int _flush_async_dirops(Inode *dir);
   int _rename(Inode *olddir, const char *oname, Inode *ndir, const char *nname, const UserPerm& perm);
   int _mkdir(Inode *dir, const char *name, mode_t mode, const UserPerm& perm,
 	     InodeRef *inp = 0);
@@ -820,6 +863,8 @@ private:
   int _listxattr(Inode *in, char *names, size_t len, const UserPerm& perms);
   int _do_setxattr(Inode *in, const char *name, const void *value, size_t len,
 		   int flags, const UserPerm& perms);
+  int _setxattr_buffered(Inode *in, const char *name, const void *value,
+			 size_t len, int xattr_flags, const UserPerm& perms);
   int _setxattr(Inode *in, const char *name, const void *value, size_t len,
 		int flags, const UserPerm& perms);
   int _setxattr(InodeRef &in, const char *name, const void *value, size_t len,
@@ -837,6 +882,8 @@ private:
 
   loff_t _lseek(Fh *fh, loff_t offset, int whence);
   int _read(Fh *fh, int64_t offset, uint64_t size, bufferlist *bl);
+  void _prefetch_siblings(Inode *in, const UserPerm& perms);
+  void _prefetch_small_file(Inode *in, const UserPerm& perms);
   int _write(Fh *fh, int64_t offset, uint64_t size, const char *buf,
           const struct iovec *iov, int iovcnt);
   int _preadv_pwritev(int fd, const struct iovec *iov, unsigned iovcnt, int64_t offset, bool write);
@@ -1130,6 +1177,9 @@ public:
   int get_caps_issued(int fd);
   int get_caps_issued(const char *path, const UserPerm& perms);
 
+  // requests sent to each mds rank since mount
+  void get_mds_request_counts(map<mds_rank_t, uint64_t> *counts);
+
   // low-level interface v2
   inodeno_t ll_get_inodeno(Inode *in) {
     Mutex::Locker lock(client_lock);
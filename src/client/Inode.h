@@ -5,6 +5,7 @@
 #define CEPH_CLIENT_INODE_H
 
 #include <numeric>
+#include <mutex>
 
 #include "include/types.h"
 #include "include/xlist.h"
@@ -17,6 +18,7 @@
 #include "InodeRef.h"
 #include "UserPerm.h"
 #include "Delegation.h"
+#include "include/cephfs/ceph_statx.h"
 
 class Client;
 struct MetaSession;
@@ -198,6 +200,7 @@ struct Inode {
   string    symlink;  // symlink content, if it's a symlink
   map<string,bufferptr> xattrs;
   map<frag_t,int> fragmap;  // known frag -> mds mappings
+  map<frag_t,set<mds_rank_t> > frag_repmap;  // known frag -> replica holders (incl. auth)
 
   list<Cond*>       waitfor_caps;
   list<Cond*>       waitfor_commit;
@@ -236,6 +239,41 @@ struct Inode {
 
   std::set<Fh*> fhs;
 
+  // asynchronous dirops still on their way to the MDS that involve this
+  // inode, as parent directory or as target; and, for a parent, how many
+  // of them have not even been sent yet.  While any have not, lease and
+  // Fs revokes on the dir are not acked (see Client::_async_dirop_sent).
+  int async_dirops;
+  int async_dirops_unsent;
+  list<Cond*> waitfor_async_dirops;
+
+  // lookups in this dir the MDS answered with ENOENT since we last
+  // read it completely, and the shared_gen we last did that under (see
+  // client_negative_lookup_prefetch)
+  unsigned enoent_lookups;
+  int enoent_fill_gen;
+
+  // read-only opens of this dir's files in readdir order (see
+  // client_small_file_prefetch): the fpos of the last one, how many
+  // followed each other, and the fpos we have prefetched up to
+  int64_t scan_last_off, scan_prefetch_off;
+  unsigned scan_run;
+
+  // Attributes last handed out by ll_getattr[x] under client_lock, so
+  // that later calls can answer without it.  Good while
+  // Client::attr_epoch is unchanged, the caps they relied on have not
+  // expired, and the caller wants no more than 'mask'.
+  struct attr_snapshot_t {
+    uint64_t epoch = 0;
+    unsigned mask = 0;
+    utime_t valid_until;
+    bool have_stat = false;
+    struct stat st;
+    struct ceph_statx stx;
+  };
+  std::mutex attr_snap_lock;
+  attr_snapshot_t attr_snap;
+
   Inode(Client *c, vinodeno_t vino, file_layout_t *newlayout)
     : client(c), ino(vino.ino), snapid(vino.snapid), faked_ino(0),
       rdev(0), mode(0), uid(0), gid(0), nlink(0),
@@ -252,7 +290,9 @@ struct Inode {
       oset((void *)this, newlayout->pool_id, this->ino),
       reported_size(0), wanted_max_size(0), requested_max_size(0),
       _ref(0), ll_ref(0), dn_set(),
-      fcntl_locks(NULL), flock_locks(NULL)
+      fcntl_locks(NULL), flock_locks(NULL),
+      async_dirops(0), async_dirops_unsent(0), enoent_lookups(0), enoent_fill_gen(-1),
+      scan_last_off(0), scan_prefetch_off(0), scan_run(0)
   {
     memset(&dir_layout, 0, sizeof(dir_layout));
     memset(&quota, 0, sizeof(quota));
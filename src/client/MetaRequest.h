@@ -52,6 +52,8 @@ public:
   MClientReply *reply;         // the reply
   bool kick;
   bool success;
+  bool async_dirop;            // already applied locally, sent by a worker
+  bool async_unsent;           // async dirop still queued for its worker
   
   // readdir result
   dir_result_t *dirp;
@@ -83,7 +85,7 @@ public:
     mds(-1), resend_mds(-1), send_to_auth(false), sent_on_mseq(0),
     num_fwd(0), retry_attempt(0),
     reply(0), 
-    kick(false), success(false),
+    kick(false), success(false), async_dirop(false), async_unsent(false),
     got_unsafe(false), item(this), unsafe_item(this),
     unsafe_dir_item(this), unsafe_target_item(this),
     caller_cond(0), dispatch_cond(0) {
@@ -197,6 +199,10 @@ public:
       return false;
     return true;
   }
+  // read-only ops that a rank holding a dirfrag replica may answer
+  bool replica_readable() const {
+    return head.op == CEPH_MDS_OP_LOOKUP || head.op == CEPH_MDS_OP_GETATTR;
+  }
   bool auth_is_best() {
     if ((head.op & CEPH_MDS_OP_WRITE) || head.op == CEPH_MDS_OP_OPEN ||
 	head.op == CEPH_MDS_OP_READDIR) 
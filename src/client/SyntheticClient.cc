@@ -49,6 +49,7 @@ using namespace std;
 //void trace_openssh(SyntheticClient *syn, Client *cl, string& prefix);
 
 int num_client = 1;
+static int next_client_index = 0;
 list<int> syn_modes;
 list<int> syn_iargs;
 list<string> syn_sargs;
@@ -189,6 +190,11 @@ void parse_syn_options(vector<const char*>& args)
         syn_sargs.push_back( args[++i] );
         syn_iargs.push_back( atoi(args[++i]) );
 	syn_iargs.push_back(1);// data
+      } else if (strcmp(args[i],"replay") == 0) {
+        syn_modes.push_back( SYNCLIENT_MODE_REPLAY );
+        syn_sargs.push_back( args[++i] );             // trace file
+        syn_iargs.push_back( atoi(args[++i]) );       // speed, % of real time
+        syn_sargs.push_back( args[++i] );             // path prefix
       } else if (strcmp(args[i],"mtrace") == 0) {
         syn_modes.push_back( SYNCLIENT_MODE_TRACE );
         syn_sargs.push_back( args[++i] );
@@ -269,6 +275,7 @@ SyntheticClient::SyntheticClient(StandaloneClient *client, int w)
 {
   this->client = client;
   whoami = w;
+  index = next_client_index++;
   thread_id = 0;
   
   did_readdir = false;
@@ -820,6 +827,20 @@ int SyntheticClient::run()
       break;
 
 
+    case SYNCLIENT_MODE_REPLAY:
+      {
+        string tfile = get_sarg(0);
+        int speed = iargs.front();  iargs.pop_front();
+        string prefix = sargs.front();  sargs.pop_front();
+        if (prefix == "~" || prefix == "/")
+          prefix.clear();
+        if (run_me()) {
+          replay_trace(tfile, speed, prefix);
+        }
+        did_run_me();
+      }
+      break;
+
     case SYNCLIENT_MODE_OPENTEST:
       {
         int count = iargs.front();  iargs.pop_front();
@@ -1548,6 +1569,309 @@ int SyntheticClient::play_trace(Trace& t, string& prefix, bool metadata_only)
 
 
 
+/*
+ * Trace replay
+ *
+ * Replays the " TRACE_COLLECTION <op> <path> [args]" lines that a client
+ * built with TRACE_COLLECTION logs.  Every synclient reads the whole
+ * trace, so they all agree on the time origin, and keeps the ops of the
+ * original clients that map to it; the ops of one original client thus
+ * stay in order on one replayer.  Synclient 0 populates the namespace
+ * for the whole trace, then all of them meet at a barrier and share one
+ * start stamp.  With speed > 0 ops are issued at their recorded offset
+ * scaled by 100/speed, with speed 0 back to back.
+ */
+
+static Mutex replay_lock("synclient replay lock");
+static Cond replay_cond;
+static int replay_waiting = 0;
+static uint64_t replay_round = 0;
+static utime_t replay_start;
+
+static utime_t replay_barrier()
+{
+  Mutex::Locker l(replay_lock);
+  uint64_t round = replay_round;
+  if (++replay_waiting == num_client) {
+    replay_waiting = 0;
+    replay_start = ceph_clock_now();
+    replay_round++;
+    replay_cond.SignalAll();
+  } else {
+    while (round == replay_round)
+      replay_cond.Wait(replay_lock);
+  }
+  return replay_start;
+}
+
+void SyntheticClient::replay_stat_t::add(utime_t lat, int r)
+{
+  count++;
+  if (r < 0)
+    errors++;
+  sum += (double)lat;
+  uint64_t usec = lat.to_nsec() / 1000;
+  int b = 0;
+  while (usec > 1 && b < 31) {
+    usec >>= 1;
+    b++;
+  }
+  hist[b]++;
+}
+
+double SyntheticClient::replay_stat_t::percentile(double p) const
+{
+  uint64_t want = (uint64_t)ceil(p * count);
+  uint64_t seen = 0;
+  for (int b = 0; b < 32; b++) {
+    if (hist[b] && seen + hist[b] >= want) {
+      // assume latencies are spread evenly across the bucket
+      double lo = b ? (double)(1ull << b) : 0;
+      double hi = (double)(1ull << (b + 1));
+      double frac = (double)(want - seen) / hist[b];
+      return (lo + frac * (hi - lo)) / 1000000.0;
+    }
+    seen += hist[b];
+  }
+  return 0;
+}
+
+bool SyntheticClient::parse_replay_line(const string& line, int64_t *src,
+					replay_op_t *op)
+{
+  size_t pos = line.find("TRACE_COLLECTION");
+  if (pos == string::npos)
+    return false;
+
+  // "<date> <time> <thread> <level> client.<id> ..."
+  std::istringstream head(line.substr(0, pos));
+  string date, time, tok;
+  head >> date >> time;
+  uint64_t sec, nsec;
+  if (utime_t::parse_date(date + " " + time, &sec, &nsec) < 0)
+    return false;
+  op->stamp = utime_t(sec, nsec);
+  *src = 0;
+  while (head >> tok) {
+    if (tok.compare(0, 7, "client.") == 0)
+      *src = atoll(tok.c_str() + 7);
+  }
+
+  std::istringstream tail(line.substr(pos + strlen("TRACE_COLLECTION")));
+  if (!(tail >> op->op >> op->path))
+    return false;
+  while (tail >> tok)
+    op->args.push_back(tok);
+
+  // paths are printed relative to an inode, "#0x1/a/b"
+  if (op->path[0] == '#') {
+    size_t slash = op->path.find('/');
+    op->path = slash == string::npos ? string() : op->path.substr(slash + 1);
+  }
+  if (op->path.empty() || op->path[0] != '/')
+    op->path = "/" + op->path;
+  return true;
+}
+
+static bool replay_op_creates(const string& op)
+{
+  return op == "create" || op == "mknod" || op == "mkdir" || op == "symlink";
+}
+
+static bool replay_op_on_dir(const string& op)
+{
+  return op == "readdir" || op == "opendir" || op == "closedir" ||
+	 op == "fsyncdir" || op == "rmdir";
+}
+
+void SyntheticClient::replay_populate(const vector<replay_op_t>& ops,
+				      const UserPerm& perms)
+{
+  // whatever the trace touches before creating it has to exist already
+  set<string> dirs, files, created;
+  for (const auto& op : ops) {
+    filepath fp(op.path.c_str());
+    string parent;
+    for (unsigned i = 0; i + 1 < fp.depth(); i++) {
+      parent += "/" + fp[i];
+      dirs.insert(parent);
+    }
+    if (created.count(op.path))
+      continue;
+    if (replay_op_creates(op.op))
+      created.insert(op.path);
+    else if (replay_op_on_dir(op.op))
+      dirs.insert(op.path);
+    else
+      files.insert(op.path);
+  }
+
+  for (const auto& d : dirs)
+    client->mkdir(d.c_str(), 0755, perms);
+  for (const auto& f : files) {
+    if (dirs.count(f))
+      continue;
+    int fd = client->open(f.c_str(), O_CREAT|O_WRONLY, perms, 0644);
+    if (fd >= 0)
+      client->close(fd);
+  }
+  dout(1) << "replay populated " << dirs.size() << " dirs, "
+	  << files.size() << " files" << dendl;
+}
+
+int SyntheticClient::replay_op(const replay_op_t& op, const UserPerm& perms)
+{
+  const char *path = op.path.c_str();
+  string arg0 = op.args.size() > 0 ? op.args[0] : string("user.replay");
+  string arg1 = op.args.size() > 1 ? op.args[1] : string();
+  char buf[4096];
+  struct stat st;
+
+  if (op.op == "lookup" || op.op == "getattr")
+    return client->lstat(path, &st, perms);
+  if (op.op == "setattr") {
+    struct utimbuf ut;
+    ut.actime = ut.modtime = time(0);
+    return client->utime(path, &ut, perms);
+  }
+  if (op.op == "readdir") {
+    list<string> names;
+    return client->getdir(path, names, perms);
+  }
+  if (op.op == "getxattr") {
+    int r = client->getxattr(path, arg0.c_str(), buf, sizeof(buf), perms);
+    return r < 0 ? r : 0;
+  }
+  if (op.op == "listxattr") {
+    int r = client->listxattr(path, buf, sizeof(buf), perms);
+    return r < 0 ? r : 0;
+  }
+  if (op.op == "setxattr")
+    return client->setxattr(path, arg0.c_str(), arg1.c_str(), arg1.length(),
+			    0, perms);
+  if (op.op == "removexattr")
+    return client->removexattr(path, arg0.c_str(), perms);
+  if (op.op == "mknod")
+    return client->mknod(path, S_IFREG|0644, perms);
+  if (op.op == "mkdir")
+    return client->mkdir(path, 0755, perms);
+  if (op.op == "symlink")
+    return client->symlink(arg0.c_str(), path, perms);
+  if (op.op == "unlink")
+    return client->unlink(path, perms);
+  if (op.op == "rmdir")
+    return client->rmdir(path, perms);
+  if (op.op == "rename" || op.op == "link") {
+    // the trace only records the new name; assume the same directory
+    string to = op.path.substr(0, op.path.rfind('/') + 1) + arg0;
+    if (op.op == "rename")
+      return client->rename(path, to.c_str(), perms);
+    return client->link(path, to.c_str(), perms);
+  }
+  if (op.op == "open.r" || op.op == "open.w" || op.op == "create") {
+    int flags = O_RDONLY;
+    if (op.op == "open.w")
+      flags = O_WRONLY;
+    else if (op.op == "create")
+      flags = O_WRONLY|O_CREAT;
+    int fd = client->open(path, flags, perms, 0644);
+    if (fd < 0)
+      return fd;
+    client->close(fd);
+    return 0;
+  }
+  // data and handle ops (read, write, close, ...) are not replayed
+  return -EOPNOTSUPP;
+}
+
+int SyntheticClient::replay_trace(const string& fn, int speed,
+				  const string& prefix)
+{
+  UserPerm perms = client->pick_my_perms();
+
+  ifstream in(fn.c_str());
+  if (!in.is_open()) {
+    dout(0) << "replay: can't open " << fn << dendl;
+    return -ENOENT;
+  }
+  vector<replay_op_t> ops, all_ops;
+  utime_t first;
+  string line;
+  while (getline(in, line)) {
+    replay_op_t op;
+    int64_t src;
+    if (!parse_replay_line(line, &src, &op))
+      continue;
+    if (first.is_zero())
+      first = op.stamp;
+    op.path = prefix + op.path;
+    if (index == 0)
+      all_ops.push_back(op);
+    if (src % num_client != index)
+      continue;
+    ops.push_back(op);
+  }
+  dout(0) << "replay " << fn << " shard " << index << "/" << num_client
+	  << ": " << ops.size() << " ops, speed " << speed << "%" << dendl;
+
+  if (index == 0) {
+    if (prefix.length())
+      client->mkdir(prefix.c_str(), 0755, perms);
+    replay_populate(all_ops, perms);
+    all_ops.clear();
+  }
+
+  map<mds_rank_t, uint64_t> rank_start, rank_end;
+  client->get_mds_request_counts(&rank_start);
+
+  map<string, replay_stat_t> stats;
+  uint64_t skipped = 0;
+  utime_t start = replay_barrier();
+  for (const auto& op : ops) {
+    if (time_to_stop())
+      break;
+    if (speed > 0) {
+      utime_t offset;
+      offset.set_from_double((double)(op.stamp - first) * 100.0 / speed);
+      utime_t due = start + offset;
+      utime_t now = ceph_clock_now();
+      if (due > now)
+	(due - now).sleep();
+    }
+    utime_t t = ceph_clock_now();
+    int r = replay_op(op, perms);
+    if (r == -EOPNOTSUPP) {
+      skipped++;
+      continue;
+    }
+    stats[op.op].add(ceph_clock_now() - t, r);
+  }
+  utime_t elapsed = ceph_clock_now() - start;
+  client->get_mds_request_counts(&rank_end);
+
+  uint64_t total = 0;
+  for (const auto& p : stats)
+    total += p.second.count;
+  dout(0) << "replay done: " << total << " ops (" << skipped << " skipped) in "
+	  << elapsed << " s, " << (double)total / MAX((double)elapsed, 1e-9)
+	  << " ops/s" << dendl;
+  for (const auto& p : stats) {
+    const replay_stat_t& s = p.second;
+    dout(0) << "replay op " << p.first << " n " << s.count
+	    << " err " << s.errors
+	    << " avg " << s.sum / s.count
+	    << " p50 " << s.percentile(.5)
+	    << " p99 " << s.percentile(.99)
+	    << " p999 " << s.percentile(.999) << dendl;
+  }
+  for (const auto& p : rank_end) {
+    uint64_t before = rank_start.count(p.first) ? rank_start[p.first] : 0;
+    dout(0) << "replay mds." << p.first << " requests " << p.second - before
+	    << dendl;
+  }
+  return 0;
+}
+
 int SyntheticClient::clean_dir(string& basedir)
 {
   // read dir
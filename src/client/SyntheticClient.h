@@ -55,6 +55,7 @@
 #define SYNCLIENT_MODE_DROPCACHE   29
 
 #define SYNCLIENT_MODE_TRACE       30
+#define SYNCLIENT_MODE_REPLAY      31     // tracefile speed prefix
 
 #define SYNCLIENT_MODE_CREATEOBJECTS 35
 #define SYNCLIENT_MODE_OBJECTRW 36
@@ -100,6 +101,7 @@ extern int num_client;
 class SyntheticClient {
   StandaloneClient *client;
   int whoami;
+  int index;   // 0..num_client-1, in creation order
 
   pthread_t thread_id;
 
@@ -259,6 +261,26 @@ class SyntheticClient {
 
   int play_trace(Trace& t, string& prefix, bool metadata_only=false);
 
+  // replay of TRACE_COLLECTION client logs
+  struct replay_op_t {
+    utime_t stamp;
+    string op;
+    string path;
+    vector<string> args;
+  };
+  struct replay_stat_t {
+    uint64_t count = 0, errors = 0;
+    double sum = 0;
+    uint64_t hist[32] = {};    // log2 buckets of latency in usec
+    void add(utime_t lat, int r);
+    double percentile(double p) const;
+  };
+  static bool parse_replay_line(const string& line, int64_t *src,
+				replay_op_t *op);
+  void replay_populate(const vector<replay_op_t>& ops, const UserPerm& perms);
+  int replay_op(const replay_op_t& op, const UserPerm& perms);
+  int replay_trace(const string& fn, int speed, const string& prefix);
+
   void make_dir_mess(const char *basedir, int n);
   void foo();
 
@@ -351,6 +351,17 @@ OPTION(mon_pool_quota_crit_threshold, OPT_INT) // percent of quota at which to i
 OPTION(client_cache_size, OPT_INT)
 OPTION(client_cache_mid, OPT_FLOAT)
 OPTION(client_use_random_mds, OPT_BOOL)
+OPTION(client_lockless_getattr, OPT_BOOL) // serve cached getattrs without client_lock
+OPTION(client_readdir_max_bytes, OPT_U64) // cap on the growing readdir chunk size
+OPTION(client_buffered_xattrs, OPT_BOOL) // setxattr under Xx rides the next cap flush
+OPTION(client_async_dirops, OPT_BOOL) // acknowledge leased unlinks before the MDS replies
+OPTION(client_async_dirops_threads, OPT_INT)
+OPTION(client_negative_lookup_prefetch, OPT_INT) // lookup misses before reading the whole dir
+OPTION(client_negative_lookup_prefetch_max_entries, OPT_INT)
+OPTION(client_small_file_prefetch, OPT_INT) // files to prefetch ahead of a readdir-order scan
+OPTION(client_small_file_prefetch_max_size, OPT_U64)
+OPTION(client_small_file_prefetch_threads, OPT_INT)
+OPTION(client_replica_reads, OPT_BOOL)  // send lookup/getattr to dirfrag replica holders
 OPTION(client_mount_timeout, OPT_DOUBLE)
 OPTION(client_tick_interval, OPT_DOUBLE)
 OPTION(client_trace, OPT_STR)
@@ -448,10 +459,13 @@ OPTION(mds_tick_interval, OPT_FLOAT)
 OPTION(mds_dirstat_min_interval, OPT_FLOAT)    // try to avoid propagating more often than this
 OPTION(mds_scatter_nudge_interval, OPT_FLOAT)  // how quickly dirstat changes propagate up the hierarchy
 OPTION(mds_client_prealloc_inos, OPT_INT)
+OPTION(mds_client_prealloc_inos_max, OPT_INT) // grow prealloc up to this for fast creators
 OPTION(mds_early_reply, OPT_BOOL)
 OPTION(mds_default_dir_hash, OPT_INT)
 OPTION(mds_log_pause, OPT_BOOL)
 OPTION(mds_log_skip_corrupt_events, OPT_BOOL)
+OPTION(mds_log_replay_batch, OPT_INT) // events applied per mds_lock acquisition in replay
+OPTION(mds_log_replay_prefetch_periods, OPT_INT) // journaler_prefetch_periods while replaying
 OPTION(mds_log_max_events, OPT_INT)
 OPTION(mds_log_events_per_segment, OPT_INT)
 OPTION(mds_log_segment_size, OPT_INT)  // segment size for mds log, default to default file_layout_t
@@ -465,6 +479,7 @@ OPTION(mds_bal_split_size, OPT_INT)
 OPTION(mds_bal_split_rd, OPT_FLOAT)
 OPTION(mds_bal_split_wr, OPT_FLOAT)
 OPTION(mds_bal_split_bits, OPT_INT)
+OPTION(mds_bal_split_heat_bits, OPT_INT) // hash ranges tracked per dirfrag for hot splits
 OPTION(mds_bal_merge_size, OPT_INT)
 OPTION(mds_bal_interval, OPT_INT)           // seconds
 OPTION(mds_bal_fragment_interval, OPT_INT)      // seconds
@@ -478,6 +493,9 @@ OPTION(mds_bal_ifthreshold, OPT_FLOAT)
 OPTION(mds_bal_ifenable, OPT_INT)
 OPTION(mds_bal_max, OPT_INT)
 OPTION(mds_bal_max_until, OPT_INT)
+OPTION(mds_client_auth_hints, OPT_BOOL) // push dirfrag auth hints to clients after import
+OPTION(mds_bal_heartbeat_subtrees, OPT_INT) // top-K subtrees per heartbeat
+OPTION(mds_bal_summary_full_interval, OPT_INT) // full subtree summary every N epochs
 OPTION(mds_bal_mode, OPT_INT)
 OPTION(mds_bal_min_rebalance, OPT_FLOAT)  // must be this much above average before we export anything
 OPTION(mds_bal_min_start, OPT_FLOAT)      // if we need less than this, we don't do anything
@@ -541,11 +559,17 @@ OPTION(mds_max_purge_ops, OPT_U32)
 OPTION(mds_max_purge_ops_per_pg, OPT_FLOAT)
 
 OPTION(mds_purge_queue_busy_flush_period, OPT_FLOAT)
+OPTION(mds_purge_queue_read_ahead, OPT_U32)
+OPTION(mds_purge_target_latency, OPT_FLOAT)  // seconds
+OPTION(mds_purge_max_scale, OPT_FLOAT)
 
 OPTION(mds_root_ino_uid, OPT_INT) // The UID of / on new filesystems
 OPTION(mds_root_ino_gid, OPT_INT) // The GID of / on new filesystems
 
 OPTION(mds_max_scrub_ops_in_progress, OPT_INT) // the number of simultaneous scrubs allowed
+OPTION(mds_scrub_parallel_dirs, OPT_INT) // waiting dirs scrub may skip past to other subtrees
+OPTION(mds_scrub_target_latency, OPT_FLOAT) // back off above this validate latency
+OPTION(mds_scrub_busy_queue_len, OPT_INT) // one scrub op at a time above this dispatch queue
 
 // Maximum number of damaged frags/dentries before whole MDS rank goes damaged
 OPTION(mds_damage_table_max_entries, OPT_INT)
@@ -5992,6 +5992,11 @@ std::vector<Option> get_mds_options() {
     .set_default(1000)
     .set_description(""),
 
+    Option("mds_client_prealloc_inos_max", Option::TYPE_INT, Option::LEVEL_ADVANCED)
+    .set_default(16384)
+    .set_description("upper bound for inos preallocated to a client that creates files quickly")
+    .set_long_description("Each session's preallocated ino range grows from mds_client_prealloc_inos towards this value with the client's recent create rate, so busy clients refill the range (and journal the InoTable update) less often. Set equal to mds_client_prealloc_inos to disable."),
+
     Option("mds_early_reply", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
     .set_default(true)
     .set_description(""),
@@ -6004,6 +6009,15 @@ std::vector<Option> get_mds_options() {
     .set_default(false)
     .set_description(""),
 
+    Option("mds_log_replay_batch", Option::TYPE_INT, Option::LEVEL_ADVANCED)
+    .set_default(256)
+    .set_description("journal events decoded and applied per mds_lock acquisition during replay"),
+
+    Option("mds_log_replay_prefetch_periods", Option::TYPE_INT, Option::LEVEL_ADVANCED)
+    .set_default(16)
+    .set_description("journal objects to read ahead during replay")
+    .set_long_description("Overrides journaler_prefetch_periods while the journal is replayed."),
+
     Option("mds_log_skip_corrupt_events", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
     .set_default(false)
     .set_description(""),
@@ -6060,6 +6074,12 @@ std::vector<Option> get_mds_options() {
     .set_default(3)
     .set_description(""),
 
+    Option("mds_bal_split_heat_bits", Option::TYPE_INT, Option::LEVEL_ADVANCED)
+    .set_default(4)
+    .set_min_max(0, 8)
+    .set_description("track dirfrag access heat in 2^N hash ranges")
+    .set_long_description("Hot dirfrags are split by as many bits (up to N) as it takes for the hottest resulting fragment to stop dominating, instead of always by mds_bal_split_bits. 0 disables heat tracking."),
+
     Option("mds_bal_merge_size", Option::TYPE_INT, Option::LEVEL_ADVANCED)
     .set_default(50)
     .set_description(""),
@@ -6112,6 +6132,18 @@ std::vector<Option> get_mds_options() {
     .set_default(-1)
     .set_description(""),
 
+    Option("mds_client_auth_hints", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(true)
+    .set_description("tell clients with caps in an imported subtree that this rank now serves it"),
+
+    Option("mds_bal_heartbeat_subtrees", Option::TYPE_INT, Option::LEVEL_ADVANCED)
+    .set_default(16)
+    .set_description("number of hottest auth subtrees each rank advertises in its heartbeat"),
+
+    Option("mds_bal_summary_full_interval", Option::TYPE_INT, Option::LEVEL_ADVANCED)
+    .set_default(8)
+    .set_description("epochs between full subtree summaries; heartbeats in between carry only changes"),
+
     Option("mds_bal_mode", Option::TYPE_INT, Option::LEVEL_ADVANCED)
     .set_default(0)
     .set_description(""),
@@ -6336,6 +6368,19 @@ std::vector<Option> get_mds_options() {
     .set_default(1.0)
     .set_description(""),
 
+    Option("mds_purge_queue_read_ahead", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(256)
+    .set_description("purge queue items read ahead and queued per data pool"),
+
+    Option("mds_purge_target_latency", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(0.5)
+    .set_description("purge latency (seconds) above which a pool's purge rate backs off")
+    .set_long_description("Each data pool's share of the purge op limit grows while purges in it complete within this time and shrinks when they take longer. 0 keeps the static limits."),
+
+    Option("mds_purge_max_scale", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(4.0)
+    .set_description("how far a pool's purge op limit may be scaled up (or down, as its inverse)"),
+
     Option("mds_root_ino_uid", Option::TYPE_INT, Option::LEVEL_ADVANCED)
     .set_default(0)
     .set_description(""),
@@ -6348,6 +6393,18 @@ std::vector<Option> get_mds_options() {
     .set_default(5)
     .set_description(""),
 
+    Option("mds_scrub_parallel_dirs", Option::TYPE_INT, Option::LEVEL_ADVANCED)
+    .set_default(4)
+    .set_description("directories that may be waiting on fetches or children while scrub moves on to other subtrees"),
+
+    Option("mds_scrub_target_latency", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(1.0)
+    .set_description("inode validation latency (seconds) above which scrub lowers its op limit; 0 disables"),
+
+    Option("mds_scrub_busy_queue_len", Option::TYPE_INT, Option::LEVEL_ADVANCED)
+    .set_default(100)
+    .set_description("dispatch queue length above which scrub runs one op at a time; 0 disables"),
+
     Option("mds_damage_table_max_entries", Option::TYPE_INT, Option::LEVEL_ADVANCED)
     .set_default(10000)
     .set_description(""),
@@ -6383,6 +6440,57 @@ std::vector<Option> get_mds_client_options() {
     .set_default(false)
     .set_description(""),
 
+    Option("client_lockless_getattr", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(true)
+    .set_description("answer cached ll_getattr calls without taking the client lock")
+    .set_long_description("Repeated getattrs on an inode whose caps are unchanged since the last one are served from a per-inode snapshot, so multithreaded ceph-fuse stats do not serialize on the client lock."),
+
+    Option("client_readdir_max_bytes", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(8 << 20)
+    .set_description("largest readdir chunk to ask the MDS for")
+    .set_long_description("The first chunk of a readdir uses the MDS default size; every following chunk of the same scan doubles, up to this many bytes. 0 always uses the MDS default."),
+
+    Option("client_buffered_xattrs", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(true)
+    .set_description("apply user/security/trusted setxattrs locally while holding Xx")
+    .set_long_description("The xattrs travel to the MDS with the next cap flush, together with any other dirty metadata, instead of as one setxattr request each."),
+
+    Option("client_async_dirops", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_description("complete unlinks locally and send them to the MDS in the background")
+    .set_long_description("When the client holds a valid lease on the dentry of a non-directory, unlink() returns as soon as the dentry is dropped from the local cache; worker threads then carry the request to the MDS. Later operations on the directory or the unlinked inode wait for those requests, and a failure is returned by the next fsync of the directory."),
+
+    Option("client_async_dirops_threads", Option::TYPE_INT, Option::LEVEL_ADVANCED)
+    .set_default(8)
+    .set_description("number of asynchronous dirops that may be in flight to the MDS at once"),
+
+    Option("client_negative_lookup_prefetch", Option::TYPE_INT, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_description("read a whole directory after this many lookup misses in it (0 disables)")
+    .set_long_description("Once a directory whose Fs cap we hold has answered this many lookups with ENOENT, the client reads it completely. With the directory complete, later misses in it are answered from the client cache instead of the MDS. A directory is read this way at most once per Fs cap generation, and lookups that precede a create in it are not counted."),
+
+    Option("client_negative_lookup_prefetch_max_entries", Option::TYPE_INT, Option::LEVEL_ADVANCED)
+    .set_default(4096)
+    .set_description("largest directory that client_negative_lookup_prefetch will read"),
+
+    Option("client_small_file_prefetch", Option::TYPE_INT, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_description("files to prefetch ahead of a directory-order read scan (0 disables)")
+    .set_long_description("When files of a directory are opened read-only one after another in readdir order, the client opens the next this many small files in the background. It reads their first object into the object cache, so the application's own open and read are answered locally."),
+
+    Option("client_small_file_prefetch_max_size", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(4 << 20)
+    .set_description("largest file client_small_file_prefetch will read"),
+
+    Option("client_small_file_prefetch_threads", Option::TYPE_INT, Option::LEVEL_ADVANCED)
+    .set_default(4)
+    .set_description("background threads for client_small_file_prefetch; bounds the prefetches in flight"),
+
+    Option("client_replica_reads", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_description("send lookup/getattr to ranks holding a replica of the dirfrag")
+    .set_long_description("When an MDS replicates a hot dirfrag it reports the replica holders in its replies. With this option the client spreads read-only lookup and getattr requests for that dirfrag over those ranks instead of always sending them to the auth rank."),
+
     Option("client_mount_timeout", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
     .set_default(300.0)
     .set_description(""),
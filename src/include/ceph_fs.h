@@ -116,6 +116,7 @@ struct ceph_dir_layout {
 #define CEPH_MSG_CLIENT_SNAP            0x312
 #define CEPH_MSG_CLIENT_CAPRELEASE      0x313
 #define CEPH_MSG_CLIENT_QUOTA           0x314
+#define CEPH_MSG_CLIENT_AUTH_HINT       0x315
 
 /* pool ops */
 #define CEPH_MSG_POOLOP_REPLY           48
@@ -1412,6 +1412,18 @@ int ceph_localize_reads(struct ceph_mount_info *cmount, int val);
  */
 int ceph_get_local_osd(struct ceph_mount_info *cmount);
 
+/**
+ * Get the number of requests this mount has sent to each MDS rank.
+ *
+ * @param cmount the ceph mount handle to use.
+ * @param counts array filled with the counts, indexed by rank
+ * @param len the number of entries in counts
+ * @returns highest rank this mount has sent requests to plus one (which may
+ *	exceed len), or a negative error code.
+ */
+int ceph_get_mds_request_counts(struct ceph_mount_info *cmount,
+				uint64_t *counts, int len);
+
 /** @} default_filelayout */
 
 /**
@@ -474,6 +474,24 @@ extern "C" int ceph_get_local_osd(struct ceph_mount_info *cmount)
   return cmount->get_client()->get_local_osd();
 }
 
+extern "C" int ceph_get_mds_request_counts(struct ceph_mount_info *cmount,
+					   uint64_t *counts, int len)
+{
+  if (!cmount->is_mounted())
+    return -ENOTCONN;
+  map<mds_rank_t, uint64_t> m;
+  cmount->get_client()->get_mds_request_counts(&m);
+  int n = 0;
+  for (int i = 0; i < len; i++)
+    counts[i] = 0;
+  for (const auto &p : m) {
+    if (p.first < len)
+      counts[p.first] = p.second;
+    n = MAX(n, p.first + 1);
+  }
+  return n;
+}
+
 extern "C" const char* ceph_getcwd(struct ceph_mount_info *cmount)
 {
   return cmount->get_cwd(cmount->default_perms);
@@ -1056,6 +1056,11 @@ void CDir::split(int bits, list<CDir*>& subs, list<MDSInternalContextBase*>& wai
   
   double fac = 1.0 / (double)(1 << bits);  // for scaling load vecs
 
+  // if we know where in the hash space our hits went, hand each
+  // fragment its own share of pop_me instead of an even one
+  vector<double> heat;
+  double heat_total = get_hash_heat(ceph_clock_now(), cache->decayrate, heat);
+
   version_t rstat_version = inode->get_projected_inode()->rstat.version;
   version_t dirstat_version = inode->get_projected_inode()->dirstat.version;
 
@@ -1081,7 +1086,21 @@ void CDir::split(int bits, list<CDir*>& subs, list<MDSInternalContextBase*>& wai
     f->set_version(get_version());
 
     f->pop_me = pop_me;
-    f->pop_me.scale(fac);
+    if (heat_total > 0) {
+      unsigned i = (p->value() >> p->mask_shift()) & ((1 << bits) - 1);
+      int hb = (int)cbits(heat.size()) - 1;
+      double share = 0;
+      if (bits <= hb) {
+        unsigned per = 1 << (hb - bits);
+        for (unsigned j = i * per; j < (i + 1) * per; j++)
+          share += heat[j];
+      } else {
+        share = heat[i >> (bits - hb)] / (double)(1 << (bits - hb));
+      }
+      f->pop_me.scale(share / heat_total);
+    } else {
+      f->pop_me.scale(fac);
+    }
 
     // FIXME; this is an approximation
     f->pop_nested = pop_nested;
@@ -3452,4 +3471,29 @@ double CDir::get_load(MDBalancer * bal)
   //return alpha * pop * 0.1 + beta * pot;
 }
 
+void CDir::hit_hash(__u32 hash, utime_t now, const DecayRate& rate,
+                    double amount, int heat_bits)
+{
+  // frags live in a 24-bit hash space; don't track ranges finer than that
+  int hb = MIN(heat_bits, 24 - (int)frag.bits());
+  if (hb <= 0)
+    return;
+  if (hash_heat.size() != (1u << hb))
+    hash_heat.assign(1 << hb, DecayCounter(now));
+  unsigned i = ((hash & 0xffffff) >> (24 - frag.bits() - hb)) & ((1 << hb) - 1);
+  hash_heat[i].hit(now, rate, amount);
+}
+
+double CDir::get_hash_heat(utime_t now, const DecayRate& rate,
+                           std::vector<double>& heat)
+{
+  heat.clear();
+  double total = 0;
+  for (auto& c : hash_heat) {
+    heat.push_back(c.get(now, rate));
+    total += heat.back();
+  }
+  return total;
+}
+
 MEMPOOL_DEFINE_OBJECT_FACTORY(CDir, co_dir, mds_co);
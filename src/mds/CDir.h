@@ -363,6 +363,13 @@ protected:
 
   load_spread_t pop_spread;
 
+  // access heat per hash range of this frag; empty until first hit
+  std::vector<DecayCounter> hash_heat;
+  void hit_hash(__u32 hash, utime_t now, const DecayRate& rate,
+                double amount, int heat_bits);
+  double get_hash_heat(utime_t now, const DecayRate& rate,
+                       std::vector<double>& heat);
+
   // and to provide density
   int num_dentries_nested;
   int num_dentries_auth_subtree;
@@ -550,8 +557,14 @@ private:
     std::set<mds_rank_t> dist;
     
     auth = dir_auth.first;
-    if (is_auth()) 
+    if (is_auth()) {
       get_dist_spec(dist, whoami);
+    } else if (is_rep() && auth >= 0) {
+      // a replica can't list its peers, but advertising itself and the
+      // auth keeps clients that read from replicas from losing the hint.
+      dist.insert(auth);
+      dist.insert(whoami);
+    }
 
     ::encode(frag, bl);
     ::encode(auth, bl);
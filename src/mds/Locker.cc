@@ -2062,7 +2062,8 @@ bool Locker::issue_caps(CInode *in, Capability *only_cap)
 	int op = (before & ~after) ? CEPH_CAP_OP_REVOKE : CEPH_CAP_OP_GRANT;
 	if (op == CEPH_CAP_OP_REVOKE) {
 		revoking_caps.push_back(&cap->item_revoking_caps);
-		revoking_caps_by_client[cap->get_client()].push_back(&cap->item_client_revoking_caps);
+		if (session)
+		  session->add_revoking_cap(cap);
 		cap->set_last_revoke_stamp(ceph_clock_now());
 		cap->reset_num_revoke_warnings();
 	}
@@ -3530,13 +3531,12 @@ void Locker::get_late_revoking_clients(std::list<client_t> *result) const
   }
 
   // Slow path: execute in O(N_clients)
-  std::map<client_t, xlist<Capability*> >::const_iterator client_rc_iter;
-  for (client_rc_iter = revoking_caps_by_client.begin();
-       client_rc_iter != revoking_caps_by_client.end(); ++client_rc_iter) {
-    xlist<Capability*> const &client_rc = client_rc_iter->second;
-    bool any_late = any_late_revoking_caps(client_rc);
-    if (any_late) {
-        result->push_back(client_rc_iter->first);
+  for (const auto &p : mds->sessionmap.get_sessions()) {
+    Session *session = p.second;
+    if (!session->info.inst.name.is_client())
+      continue;
+    if (any_late_revoking_caps(session->revoking_caps)) {
+        result->push_back(session->get_client());
     }
   }
 }
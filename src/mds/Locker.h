@@ -204,8 +204,8 @@ public:
 
   // Maintain a global list to quickly find if any caps are late revoking
   xlist<Capability*> revoking_caps;
-  // Maintain a per-client list to find clients responsible for late ones quickly
-  std::map<client_t, xlist<Capability*> > revoking_caps_by_client;
+  // The per-client list lives in Session::revoking_caps, so finding the
+  // clients responsible for late ones needs no lookup per revoke.
 
   // local
 public:
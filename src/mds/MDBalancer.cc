@@ -47,6 +47,8 @@ using std::vector;
 
 //#define MDS_MONITOR
 #include <unistd.h>
+#include <dirent.h>
+#include <sys/resource.h>
 #define MDS_COLDFIRST_BALANCER
 
 #define dout_context g_ceph_context
@@ -290,57 +292,319 @@ mds_load_t MDBalancer::get_load(utime_t now)
   load.req_rate = mds->get_req_rate();
   load.queue_len = messenger->get_dispatch_queue_len();
 
-  ifstream cpu(PROCPREFIX "/proc/loadavg");
-  if (cpu.is_open())
-    cpu >> load.cpu_load_avg;
-  else
-    derr << "input file " PROCPREFIX "'/proc/loadavg' not found" << dendl_impl;
+  sample_cpu(now);
+  load.cpu_load_avg = cpu_util;
+  load.cpu_busiest_thread = cpu_busiest_thread;
   
   dout(15) << "get_load " << load << dendl;
   return load;
 }
 
 /*
- * Read synchronously from RADOS using a timeout. We cannot do daemon-local
- * fallbacks (i.e. kick off async read when we are processing the map and
- * check status when we get here) with the way the mds is structured.
+ * CPU used by this daemon (in cores) since the previous sample, and the
+ * share of one core used by its busiest thread: the dispatch thread
+ * saturates long before the process as a whole does.  Samples closer
+ * together than a second reuse the previous figures.
  */
-int MDBalancer::localize_balancer()
+void MDBalancer::sample_cpu(utime_t now)
+{
+  bool first = (last_cpu_sample == utime_t());
+  double wall = now - last_cpu_sample;
+  if (!first && wall < 1.0)
+    return;
+
+  struct rusage ru;
+  if (getrusage(RUSAGE_SELF, &ru) == 0) {
+    double t = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1000000.0 +
+               ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1000000.0;
+    if (!first)
+      cpu_util = (t - last_cpu_time) / wall;
+    last_cpu_time = t;
+  }
+
+#ifdef __linux__
+  static const long hz = sysconf(_SC_CLK_TCK);
+  DIR *d = opendir(PROCPREFIX "/proc/self/task");
+  if (d) {
+    map<pid_t, uint64_t> ticks;
+    double busiest = 0.0;
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL) {
+      if (de->d_name[0] == '.')
+        continue;
+      pid_t tid = atoi(de->d_name);
+      char path[64];
+      snprintf(path, sizeof(path), PROCPREFIX "/proc/self/task/%d/stat", (int)tid);
+      ifstream f(path);
+      string line;
+      if (!getline(f, line))
+        continue;
+      // the thread name may contain spaces; fields resume after its ')'
+      size_t rp = line.rfind(')');
+      if (rp == string::npos)
+        continue;
+      std::istringstream ss(line.substr(rp + 1));
+      string field;
+      uint64_t t = 0;
+      // field 3 (state) follows the name; utime and stime are 14 and 15
+      for (int i = 3; i <= 15 && (ss >> field); ++i) {
+        if (i >= 14)
+          t += strtoull(field.c_str(), NULL, 10);
+      }
+      ticks[tid] = t;
+      auto p = last_thread_ticks.find(tid);
+      if (!first && p != last_thread_ticks.end() && t >= p->second)
+        busiest = MAX(busiest, (double)(t - p->second) / hz / wall);
+    }
+    closedir(d);
+    last_thread_ticks.swap(ticks);
+    cpu_busiest_thread = busiest;
+  }
+#endif
+
+  last_cpu_sample = now;
+}
+
+const MDBalancer::load_snapshot_t& MDBalancer::get_snapshot(utime_t now)
 {
-  /* reset everything */
-  bool ack = false;
-  int r = 0;
+  if (snapshot.epoch == beat_epoch)
+    return snapshot;
+
+  snapshot.epoch = beat_epoch;
+  snapshot.load = get_load(now);
+  snapshot.subtree_load = 0.0;
+  snapshot.dir_load.clear();
+  snapshot.top_subtrees.clear();
+  if (mds->mdcache->root) {
+    set<CDir*> subtrees;
+    mds->mdcache->get_fullauth_subtrees(subtrees);
+    for (auto dir : subtrees) {
+      if (dir->is_freezing() || dir->is_frozen() || dir->get_inode()->is_stray())
+        continue;
+      double l = dir->get_load(this);
+      snapshot.dir_load[dir->dirfrag()] = l;
+      snapshot.subtree_load += l;
+
+      subtree_summary_t s;
+      s.dirfrag = dir->dirfrag();
+      s.load = l;
+      s.size = dir->get_num_dentries_auth_subtree_nested();
+      if (dir->inode->get_export_pin() != MDS_RANK_NONE)
+        s.flags |= subtree_summary_t::FLAG_PINNED;
+      if (!dir->inode->is_base() &&
+          dir->inode->authority().first != mds->get_nodeid())
+        s.flags |= subtree_summary_t::FLAG_IMPORTED;
+      snapshot.top_subtrees.push_back(s);
+    }
+  }
+  size_t k = MAX(0, g_conf->mds_bal_heartbeat_subtrees);
+  auto hotter = [](const subtree_summary_t& a, const subtree_summary_t& b) {
+    return a.load > b.load;
+  };
+  if (snapshot.top_subtrees.size() > k) {
+    std::nth_element(snapshot.top_subtrees.begin(),
+                     snapshot.top_subtrees.begin() + k,
+                     snapshot.top_subtrees.end(), hotter);
+    snapshot.top_subtrees.resize(k);
+  }
+  std::sort(snapshot.top_subtrees.begin(), snapshot.top_subtrees.end(), hotter);
+  dout(15) << __func__ << " epoch " << beat_epoch << " " << snapshot.dir_load.size()
+           << " subtrees load " << snapshot.subtree_load << dendl;
+  return snapshot;
+}
+
+double MDBalancer::get_subtree_load(CDir *dir)
+{
+  if (snapshot.epoch == beat_epoch) {
+    auto p = snapshot.dir_load.find(dir->dirfrag());
+    if (p != snapshot.dir_load.end())
+      return p->second;
+  }
+  return dir->get_load(this);
+}
+
+static bool subtree_summary_moved(const subtree_summary_t& was,
+                            const subtree_summary_t& now)
+{
+  if (was.flags != now.flags)
+    return true;
+  if (fabs(now.load - was.load) > 0.05 * MAX(fabs(was.load), 1.0))
+    return true;
+  return abs((int64_t)now.size - (int64_t)was.size) > 0.05 * MAX(was.size, 64u);
+}
+
+/*
+ * Our top subtrees as a delta against the previous heartbeat: entries
+ * that are new or moved by more than 5%, and those that dropped out.
+ * Every mds_bal_summary_full_interval epochs (and whenever we have no
+ * base) the whole set goes out instead, so peers that missed a delta
+ * catch up.
+ */
+void MDBalancer::prepare_subtree_summary(int *base,
+                                         vector<subtree_summary_t>& changed,
+                                         vector<dirfrag_t>& gone)
+{
+  const vector<subtree_summary_t>& top = snapshot.top_subtrees;
+  int full_every = g_conf->mds_bal_summary_full_interval;
+  bool full = sent_subtrees_beat < 0 || full_every <= 1 ||
+              beat_epoch % full_every == 0;
+
+  map<dirfrag_t, subtree_summary_t> sent;
+  if (full) {
+    *base = -1;
+    changed = top;
+    for (auto& s : top)
+      sent[s.dirfrag] = s;
+  } else {
+    *base = sent_subtrees_beat;
+    for (auto& s : top) {
+      auto p = sent_subtrees.find(s.dirfrag);
+      if (p == sent_subtrees.end() || subtree_summary_moved(p->second, s)) {
+        changed.push_back(s);
+        sent[s.dirfrag] = s;
+      } else {
+        // peers still hold the old figures; compare against those next
+        // time so small drifts can't accumulate unseen
+        sent[s.dirfrag] = p->second;
+      }
+    }
+    for (auto& p : sent_subtrees) {
+      if (!sent.count(p.first))
+        gone.push_back(p.first);
+    }
+  }
+  sent_subtrees.swap(sent);
+  sent_subtrees_beat = beat_epoch;
+}
+
+void MDBalancer::handle_subtree_summary(mds_rank_t who, MHeartbeat *m)
+{
+  int base = m->get_summary_base();
+  if (base >= 0) {
+    auto p = peer_subtrees_beat.find(who);
+    if (p == peer_subtrees_beat.end() || p->second != base) {
+      dout(10) << " mds." << who << " subtree delta is against beat " << base
+               << ", which we don't have; waiting for a full summary" << dendl;
+      peer_subtrees.erase(who);
+      peer_subtrees_beat.erase(who);
+      return;
+    }
+  }
+
+  map<dirfrag_t, subtree_summary_t>& subtrees = peer_subtrees[who];
+  if (base < 0)
+    subtrees.clear();
+  for (auto& df : m->get_subtrees_gone())
+    subtrees.erase(df);
+  for (auto& s : m->get_subtrees())
+    subtrees[s.dirfrag] = s;
+  peer_subtrees_beat[who] = m->get_beat();
+  dout(15) << " mds." << who << " advertises " << subtrees.size()
+           << " subtrees" << dendl;
+}
+
+MDBalancer::MDBalancer(MDSRank *m, Messenger *msgr, MonClient *monc) :
+  mds(m),
+  messenger(msgr),
+  mon_client(monc),
+  beat_epoch(0),
+  last_epoch_under(0), my_load(0.0), target_load(0.0)
+{ }
+
+MDBalancer::~MDBalancer()
+{ }
+
+class C_Bal_LocalizeBalancer : public MDSIOContext {
+  string version;
+public:
   bufferlist lua_src;
-  Mutex lock("lock");
-  Cond cond;
+  ceph_tid_t tid = 0;
+  C_Bal_LocalizeBalancer(MDSRank *mds_, const string& v) :
+    MDSIOContext(mds_), version(v) { }
+  void finish(int r) override {
+    mds->balancer->_localize_balancer_finish(r, tid, version, lua_src);
+  }
+};
+
+/*
+ * Read the balancer from RADOS without blocking the balancer tick.  Until
+ * the read completes (and the new policy compiles) the caller falls back
+ * to the previous balancer; a read that hangs for a whole balancer
+ * interval is cancelled and retried.
+ */
+int MDBalancer::localize_balancer()
+{
+  const string& want = mds->mdsmap->get_balancer();
+
+  if (want == bal_failed_version &&
+      mds->mdsmap->get_epoch() == bal_failed_epoch)
+    return bal_failed_r;
+
+  if (bal_fetching == want) {
+    if (ceph_clock_now() - bal_fetch_start < g_conf->mds_bal_interval)
+      return -EAGAIN;
+    dout(5) << "balancer read tid=" << bal_fetch_tid << " timed out, retrying" << dendl;
+    mds->objecter->op_cancel(bal_fetch_tid, -ECANCELED);
+  }
 
   /* we assume that balancer is in the metadata pool */
-  object_t oid = object_t(mds->mdsmap->get_balancer());
+  object_t oid = object_t(want);
   object_locator_t oloc(mds->mdsmap->get_metadata_pool());
-  ceph_tid_t tid = mds->objecter->read(oid, oloc, 0, 0, CEPH_NOSNAP, &lua_src, 0,
-                                       new C_SafeCond(&lock, &cond, &ack, &r));
-  dout(15) << "launched non-blocking read tid=" << tid
+  C_Bal_LocalizeBalancer *fin = new C_Bal_LocalizeBalancer(mds, want);
+  bal_fetching = want;
+  bal_fetch_start = ceph_clock_now();
+  bal_fetch_tid = mds->objecter->read(oid, oloc, 0, 0, CEPH_NOSNAP, &fin->lua_src, 0,
+                                      new C_OnFinisher(fin, mds->finisher));
+  fin->tid = bal_fetch_tid;  // completion needs mds_lock, which we hold
+  dout(15) << "launched non-blocking read tid=" << bal_fetch_tid
            << " oid=" << oid << " oloc=" << oloc << dendl;
+  return -EAGAIN;
+}
 
-  /* timeout: if we waste half our time waiting for RADOS, then abort! */
-  double t = ceph_clock_now() + g_conf->mds_bal_interval/2;
-  utime_t timeout;
-  timeout.set_from_double(t);
-  lock.Lock();
-  int ret_t = cond.WaitUntil(lock, timeout);
-  lock.Unlock();
-
-  /* success: store the balancer in memory and set the version. */
-  if (!r) {
-    if (ret_t == ETIMEDOUT) {
-      mds->objecter->op_cancel(tid, -ECANCELED);
-      return -ETIMEDOUT;
-    }
-    bal_code.assign(lua_src.to_str());
-    bal_version.assign(oid.name);
-    dout(10) << "localized balancer, bal_code=" << bal_code << dendl;
+void MDBalancer::_localize_balancer_finish(int r, ceph_tid_t tid, const string& version,
+                                           bufferlist& lua_src)
+{
+  // a read cancelled on timeout completes after its retry was issued;
+  // only the read we are still waiting for may clear the marker
+  if (bal_fetch_tid == tid && bal_fetching == version)
+    bal_fetching.clear();
+
+  if (r == -ECANCELED)
+    return;
+  if (r < 0) {
+    derr << "failed to read balancer " << version << ": " << cpp_strerror(r) << dendl_impl;
+    mds->clog->warn() << "mantle could not read balancer=" << version
+                      << " : " << cpp_strerror(r);
+    _localize_balancer_failed(version, r);
+    return;
   }
-  return r;
+
+  /* success: compile and store the balancer in memory and set the version. */
+  string code = lua_src.to_str();
+  if (!mantle)
+    mantle.reset(new Mantle());
+  r = mantle->load(code, version);
+  if (r) {
+    mds->clog->warn() << "mantle could not load balancer=" << version
+                      << " : " << cpp_strerror(r);
+    _localize_balancer_failed(version, r);
+    return;
+  }
+  bal_failed_version.clear();
+  bal_code.swap(code);
+  bal_version.assign(version);
+  dout(10) << "localized balancer, bal_code=" << bal_code << dendl;
+
+  /* only spam the cluster log from 1 mds on version changes */
+  if (mds->get_nodeid() == 0)
+    mds->clog->info() << "mantle balancer version changed: " << bal_version;
+}
+
+void MDBalancer::_localize_balancer_failed(const string& version, int r)
+{
+  bal_failed_version = version;
+  bal_failed_epoch = mds->mdsmap->get_epoch();
+  bal_failed_r = r;
 }
 
 void MDBalancer::send_ifbeat(mds_rank_t target, double if_beate_value, vector<migration_decision_t>& migration_decision){
@@ -366,7 +630,7 @@ void MDBalancer::send_ifbeat(mds_rank_t target, double if_beate_value, vector<mi
   mds->get_mds_map()->get_up_mds_set(up);
   
   //myload
-  mds_load_t load = get_load(now);
+  mds_load_t load = get_snapshot(now).load;
   set<mds_rank_t>::iterator target_mds=up.find(target);
 
   if(target_mds==up.end()){
@@ -411,7 +675,7 @@ void MDBalancer::send_heartbeat()
   }
 
   // my load
-  mds_load_t load = get_load(now);
+  mds_load_t load = get_snapshot(now).load;
   map<mds_rank_t, mds_load_t>::value_type val(mds->get_nodeid(), load);
   mds_load.insert(val);
 
@@ -431,7 +695,7 @@ void MDBalancer::send_heartbeat()
     mds_rank_t from = im->inode->authority().first;
     if (from == mds->get_nodeid()) continue;
     if (im->get_inode()->is_stray()) continue;
-    import_map[from] += im->get_load(this);
+    import_map[from] += get_subtree_load(im);
   }
   mds_import_map[ mds->get_nodeid() ] = import_map;
   #ifdef MDS_MONITOR
@@ -461,11 +725,17 @@ void MDBalancer::send_heartbeat()
     it_up++;
   } 
   #endif
+  int summary_base;
+  vector<subtree_summary_t> summary_changed;
+  vector<dirfrag_t> summary_gone;
+  prepare_subtree_summary(&summary_base, summary_changed, summary_gone);
+
   for (set<mds_rank_t>::iterator p = up.begin(); p != up.end(); ++p) {
     if (*p == mds->get_nodeid())
       continue;
     MHeartbeat *hb = new MHeartbeat(load, beat_epoch);
     hb->get_import_map() = import_map;
+    hb->set_subtree_summary(summary_base, summary_changed, summary_gone);
     #ifdef MDS_MONITOR
     dout(7) << " MDS_MONITOR " << __func__ << " (5) send heartbeat to mds." << *p << dendl;
     #endif
@@ -763,6 +1033,7 @@ void MDBalancer::handle_heartbeat(MHeartbeat *m)
     }
   }
   mds_import_map[ who ] = m->get_import_map();
+  handle_subtree_summary(who, m);
 
   //if imbalance factor is enabled, won't use old migration
   
@@ -779,6 +1050,19 @@ void MDBalancer::handle_heartbeat(MHeartbeat *m)
       if (mds->mdsmap->get_balancer() != "") {
         int r = mantle_prep_rebalance();
         if (!r) goto out;
+        if (r == -EAGAIN) {
+          dout(5) << "mantle balancer " << mds->mdsmap->get_balancer()
+                  << " not loaded yet, using old balancer" << dendl;
+          prep_rebalance(m->get_beat());
+          goto out;
+        }
+        if (mds->mdsmap->get_balancer() == bal_failed_version) {
+          // already warned when it failed to load
+          dout(5) << "mantle balancer " << bal_failed_version
+                  << " failed to load, using old balancer" << dendl;
+          prep_rebalance(m->get_beat());
+          goto out;
+        }
 	mds->clog->warn() << "using old balancer; mantle failed for "
                           << "balancer=" << mds->mdsmap->get_balancer()
                           << " : " << cpp_strerror(r);
@@ -846,7 +1130,7 @@ double MDBalancer::try_match(balance_state_t& state, mds_rank_t ex, double& maxe
   return howmuch;
 }
 
-void MDBalancer::queue_split(const CDir *dir, bool fast)
+void MDBalancer::queue_split(const CDir *dir, bool fast, int bits)
 {
   dout(10) << __func__ << " enqueuing " << *dir
                        << " (fast=" << fast << ")" << dendl;
@@ -854,7 +1138,10 @@ void MDBalancer::queue_split(const CDir *dir, bool fast)
   assert(mds->mdsmap->allows_dirfrags());
   const dirfrag_t frag = dir->dirfrag();
 
-  auto callback = [this, frag](int r) {
+  if (bits <= 0)
+    bits = g_conf->mds_bal_split_bits;
+
+  auto callback = [this, frag, bits](int r) {
     if (split_pending.erase(frag) == 0) {
       // Someone beat me to it.  This can happen in the fast splitting
       // path, because we spawn two contexts, one with mds->timer and
@@ -876,7 +1163,7 @@ void MDBalancer::queue_split(const CDir *dir, bool fast)
     // Pass on to MDCache: note that the split might still not
     // happen if the checks in MDCache::can_fragment fail.
     dout(10) << __func__ << " splitting " << *split_dir << dendl;
-    mds->mdcache->split_dir(split_dir, g_conf->mds_bal_split_bits);
+    mds->mdcache->split_dir(split_dir, bits);
   };
 
   bool is_new = false;
@@ -1207,14 +1494,10 @@ int MDBalancer::mantle_prep_rebalance()
   balance_state_t state;
 
   /* refresh balancer if it has changed */
-  if (bal_version != mds->mdsmap->get_balancer()) {
-    bal_version.assign("");
+  if (bal_version != mds->mdsmap->get_balancer() ||
+      !mantle || !mantle->is_loaded(bal_version)) {
     int r = localize_balancer();
     if (r) return r;
-
-    /* only spam the cluster log from 1 mds on version changes */
-    if (mds->get_nodeid() == 0)
-      mds->clog->info() << "mantle balancer version changed: " << bal_version;
   }
 
   /* prepare for balancing */
@@ -1235,21 +1518,94 @@ int MDBalancer::mantle_prep_rebalance()
                   {"all.meta_load", load.all.meta_load()},
                   {"req_rate", load.req_rate},
                   {"queue_len", load.queue_len},
-                  {"cpu_load_avg", load.cpu_load_avg}};
+                  {"cpu_load_avg", load.cpu_load_avg},
+                  {"cpu_busiest_thread", load.cpu_busiest_thread}};
+
+    /* hottest subtree each rank advertised */
+    double top = 0.0;
+    if (i == mds->get_nodeid()) {
+      if (!snapshot.top_subtrees.empty())
+        top = snapshot.top_subtrees.front().load;
+    } else if (peer_subtrees.count(i)) {
+      for (auto& p : peer_subtrees[i])
+        top = MAX(top, (double)p.second.load);
+    }
+    metrics[i]["top_subtree_load"] = top;
   }
 
+  /* describe my auth subtrees so the policy can pick dirfrags itself */
+  vector<CDir*> subtree_dirs;
+  vector<mantle_subtree_t> subtrees;
+  set<CDir*> fullauthsubs;
+  mds->mdcache->get_fullauth_subtrees(fullauthsubs);
+  for (auto dir : fullauthsubs) {
+    if (dir->is_freezing() || dir->is_frozen() || dir->inode->is_stray())
+      continue;
+    mantle_subtree_t st;
+    st.dirfrag = dir->dirfrag();
+    subtree_dirs.push_back(dir);
+    subtrees.push_back(st);
+  }
+  /* the rest costs a walk of the subtree, so only pay for what the
+   * policy looks at */
+  auto fill = [this, &subtree_dirs](size_t i, mantle_subtree_t &st) {
+    CDir *dir = subtree_dirs[i];
+    dir->inode->make_path_string(st.path);
+    st.load = get_subtree_load(dir);
+    st.pot_auth = dir->pot_auth.pot_load(beat_epoch);
+    st.new_hit = dir->inode->last_newoldhit[1];
+    st.old_hit = dir->inode->last_newoldhit[0];
+    st.size = dir->get_authsubtree_size_slow(beat_epoch);
+  };
+
   /* execute the balancer */
-  Mantle mantle;
-  int ret = mantle.balance(bal_code, mds->get_nodeid(), metrics, state.targets);
-  dout(2) << " mantle decided that new targets=" << state.targets << dendl;
+  mantle_decision_t decision;
+  int ret = mantle->balance(mds->get_nodeid(), metrics, std::move(subtrees),
+                            fill, decision);
+  state.targets.swap(decision.targets);
+  dout(2) << " mantle decided that new targets=" << state.targets
+          << " exports=" << decision.exports.size()
+          << " splits=" << decision.splits.size()
+          << " merges=" << decision.merges.size() << dendl;
+  if (ret)
+    return ret;
 
-  /* mantle doesn't know about cluster size, so check target len here */
-  if ((int) state.targets.size() != cluster_size)
+  /* mantle doesn't know about cluster size, so check target len here; a
+   * policy that only names dirfrags need not return targets at all */
+  if (!(state.targets.empty() && decision.has_explicit()) &&
+      (int) state.targets.size() != cluster_size)
     return -EINVAL;
-  else if (ret)
-    return ret;
 
-  try_rebalance(state);
+  if (mds->mdsmap->allows_dirfrags()) {
+    for (auto &p : decision.splits) {
+      CDir *dir = subtree_dirs[p.first];
+      dout(7) << " mantle split " << *dir << " bits " << p.second << dendl;
+      queue_split(dir, false, p.second);
+    }
+    for (auto i : decision.merges) {
+      CDir *dir = subtree_dirs[i];
+      if (dir->get_frag() == frag_t())
+        continue;
+      dout(7) << " mantle merge " << *dir << dendl;
+      queue_merge(dir);
+    }
+  }
+
+  for (auto &p : decision.exports) {
+    CDir *dir = subtree_dirs[p.first];
+    mds_rank_t target = p.second;
+    if (target == mds->get_nodeid() || target < 0 ||
+        target >= mds_rank_t(cluster_size)) {
+      dout(1) << " mantle export of " << *dir << " to invalid mds."
+              << target << ", ignoring" << dendl;
+      continue;
+    }
+    dout(7) << " mantle exporting " << *dir << " to mds." << target << dendl;
+    mds->mdcache->migrator->export_dir_nicely(dir, target);
+  }
+
+  if (!state.targets.empty())
+    try_rebalance(state);
   return 0;
 }
 
@@ -1261,7 +1617,7 @@ void MDBalancer::simple_determine_rebalance(vector<migration_decision_t>& migrat
   set<CDir*> already_exporting;
   rebalance_time = ceph_clock_now();
   
-  int my_mds_load= calc_mds_load(get_load(rebalance_time), true);
+  int my_mds_load= calc_mds_load(get_snapshot(rebalance_time).load, true);
   int sample_count = 0;
   set<CDir*> count_candidates;
   mds->mdcache->get_fullauth_subtrees(count_candidates);
@@ -1329,7 +1685,7 @@ void MDBalancer::try_rebalance(balance_state_t& state)
     CDir *im = *it;
     if (im->get_inode()->is_stray()) continue;
 
-    double pop = im->get_load(this);
+    double pop = get_subtree_load(im);
     #ifdef MDS_MONITOR
     dout(7) << " MDS_MONITOR " << __func__ << " (2) Dir " << *im << " pop " << pop <<dendl;
     #endif
@@ -1811,7 +2167,11 @@ void MDBalancer::hit_inode(utime_t now, CInode *in, int type, int who)
   int newold = in->hit(true, beat_epoch);
 
   if (in->get_parent_dn()) {
-    hit_dir(now, in->get_parent_dn()->get_dir(), type, who, 1.0, newold);
+    CDentry *dn = in->get_parent_dn();
+    if (g_conf->mds_bal_split_heat_bits > 0 && dn->get_dir()->is_auth())
+      dn->get_dir()->hit_hash(dn->get_hash(), now, mds->mdcache->decayrate,
+                              1.0, g_conf->mds_bal_split_heat_bits);
+    hit_dir(now, dn->get_dir(), type, who, 1.0, newold);
   }
 }
 
@@ -1831,11 +2191,14 @@ void MDBalancer::maybe_fragment(CDir *dir, bool hot)
 	(dir->should_split() || hot))
     {
       dout(20) << __func__ << " mds_bal_split_size " << g_conf->mds_bal_split_size << " dir's frag size " << dir->get_frag_size() << dendl;
+      // a dir that is split for heat rather than size is split as
+      // finely as its hash-range heat says is worthwhile
+      int bits = (hot && !dir->should_split()) ? choose_split_bits(dir) : 0;
       if (split_pending.count(dir->dirfrag()) == 0) {
-        queue_split(dir, false);
+        queue_split(dir, false, bits);
       } else {
         if (dir->should_split_fast()) {
-          queue_split(dir, true);
+          queue_split(dir, true, bits);
         } else {
           dout(10) << __func__ << ": fragment already enqueued to split: "
                    << *dir << dendl;
@@ -1851,6 +2214,52 @@ void MDBalancer::maybe_fragment(CDir *dir, bool hot)
   }
 }
 
+/*
+ * Pick the split bits for a hot dirfrag from its per hash-range heat.
+ * For each candidate bit count, the hottest resulting fragment bounds
+ * how many ranks the load can be spread over (total / hottest, capped
+ * at the number of ranks).  Use the fewest bits that get within 10% of
+ * the best achievable spread; if the heat sits in a single range no
+ * split helps and we fall back to mds_bal_split_bits.
+ */
+int MDBalancer::choose_split_bits(CDir *dir)
+{
+  int bits = g_conf->mds_bal_split_bits;
+  vector<double> heat;
+  double total = dir->get_hash_heat(ceph_clock_now(), mds->mdcache->decayrate, heat);
+  if (total <= 0 || heat.size() < 2)
+    return bits;
+
+  int hb = (int)cbits(heat.size()) - 1;
+  double ranks = mds->get_mds_map()->get_num_in_mds();
+  vector<double> spread(hb + 1, 1.0);
+  for (int b = 1; b <= hb; b++) {
+    unsigned per = 1 << (hb - b);
+    double hottest = 0;
+    for (unsigned c = 0; c < (1u << b); c++) {
+      double h = 0;
+      for (unsigned j = c * per; j < (c + 1) * per; j++)
+        h += heat[j];
+      hottest = MAX(hottest, h);
+    }
+    spread[b] = MIN(ranks, total / hottest);
+  }
+
+  if (spread[hb] < 1.5) {
+    dout(10) << __func__ << " heat of " << *dir << " is concentrated, using "
+             << bits << " bits" << dendl;
+    return bits;
+  }
+  for (int b = 1; b <= hb; b++) {
+    if (spread[b] >= 0.9 * spread[hb]) {
+      dout(10) << __func__ << " " << *dir << " heat " << heat
+               << " -> " << b << " bits (spread " << spread[b] << ")" << dendl;
+      return b;
+    }
+  }
+  return hb;
+}
+
 //auto update_dir_pot_recur = [this] (CDir * dir, int level, double adj_auth_pot = 1.0, double adj_all_pot = 1.0) -> void {
 void MDBalancer::update_dir_pot_recur(CDir * dir, int level, double adj_auth_pot, double adj_all_pot)
 {
@@ -2132,21 +2541,16 @@ void MDBalancer::handle_mds_failure(mds_rank_t who)
   }
 }
 
-double MDBalancer::calc_mds_load(mds_load_t load, bool auth)
+double MDBalancer::calc_mds_load(const mds_load_t& load, bool auth)
 { 
   if (!mds->mdcache->root)
   return 0.0;
-  double dir_load_level0 = 0.0f;
-  set<CDir*> count_candidates;
-  mds->mdcache->get_fullauth_subtrees(count_candidates);
-  for (set<CDir*>::iterator pot = count_candidates.begin(); pot != count_candidates.end(); ++pot) {
-      if ((*pot)->is_freezing() || (*pot)->is_frozen() || (*pot)->get_inode()->is_stray()) continue;
-      dir_load_level0 += (*pot)->get_load(this);
-  }
+  // the same for every caller in an epoch: see get_snapshot()
+  double dir_load_level0 = get_snapshot(ceph_clock_now()).subtree_load;
 
   //vector<string> betastrs;
   //pair<double, double> result = req_tracer.alpha_beta("/", total, betastrs);
-  pair<double, double> result = mds->mdcache->root->alpha_beta(beat_epoch);
+  //pair<double, double> result = mds->mdcache->root->alpha_beta(beat_epoch);
   //double ret = load.mds_load(result.first, result.second, beat_epoch, auth, this);
   double ret = dir_load_level0;
   //dout(0) << __func__ << " load=" << load << " alpha=" << result.first << " beta=" << result.second << " dir_load_level0= " << dir_load_level0 << " pop=" << load.mds_pop_load() << " pot=" << load.mds_pot_load(auth, beat_epoch) << " result=" << ret << dendl;
@@ -19,6 +19,7 @@
 
 #include <list>
 #include <map>
+#include <memory>
 using std::list;
 using std::map;
 
@@ -30,6 +31,7 @@ using std::map;
 #include "mds/adsl/ReqTracer.h"
 
 class MDSRank;
+class Mantle;
 class Message;
 class MHeartbeat;
 class MIFBeat;
@@ -41,14 +43,10 @@ class MonClient;
 class MDBalancer {
   friend class C_Bal_SendHeartbeat;
   friend class C_Bal_SendIFbeat;
+  friend class C_Bal_LocalizeBalancer;
 public:
-  MDBalancer(MDSRank *m, Messenger *msgr, MonClient *monc) : 
-    mds(m),
-    messenger(msgr),
-    mon_client(monc),
-    beat_epoch(0),
-    last_epoch_under(0), my_load(0.0), target_load(0.0)
-    { }
+  MDBalancer(MDSRank *m, Messenger *msgr, MonClient *monc);
+  ~MDBalancer();
 
   mds_load_t get_load(utime_t);
 
@@ -68,7 +66,7 @@ public:
   void update_dir_pot_recur(CDir * dir, int level, double adj_auth_pot = 1.0, double adj_all_pot = 1.0);
   void hit_dir(utime_t now, CDir *dir, int type, int who=-1, double amount=1.0, int newold=-2);
 
-  void queue_split(const CDir *dir, bool fast);
+  void queue_split(const CDir *dir, bool fast, int bits = 0);
   void queue_merge(CDir *dir);
 
   /**
@@ -78,6 +76,7 @@ public:
    * \param hot whether the directory's temperature is enough to split it
    */
   void maybe_fragment(CDir *dir, bool hot);
+  int choose_split_bits(CDir *dir);
   
   // try to dynamically split dir
   void dynamically_fragment(CDir *dir, double amount);
@@ -110,6 +109,9 @@ private:
   void handle_export_pins(void);
   void export_empties();
   int localize_balancer();
+  void _localize_balancer_failed(const string& version, int r);
+  void _localize_balancer_finish(int r, ceph_tid_t tid, const string& version,
+                                 bufferlist& lua_src);
   void send_heartbeat();
   void send_ifbeat(mds_rank_t target, double if_beate_value, vector<migration_decision_t>& migration_decision);
   void handle_heartbeat(MHeartbeat *m);
@@ -158,8 +160,28 @@ private:
   string bal_code;
   string bal_version;
 
+  // Mantle state lives across epochs so the policy is compiled once per
+  // bal_version; the balancer object is fetched asynchronously.
+  std::unique_ptr<Mantle> mantle;
+  string bal_fetching;     // version being read from RADOS, if any
+  ceph_tid_t bal_fetch_tid = 0;
+  utime_t bal_fetch_start;
+  // a policy that could not be read or compiled, and the mdsmap epoch it
+  // failed under: not fetched (or warned about) again until either changes
+  string bal_failed_version;
+  epoch_t bal_failed_epoch = 0;
+  int bal_failed_r = 0;
+
   utime_t last_heartbeat;
   utime_t last_sample;
+
+  // CPU accounting for get_load()
+  utime_t last_cpu_sample;
+  double last_cpu_time = 0.0;    // user+sys seconds of the whole process
+  map<pid_t, uint64_t> last_thread_ticks;
+  double cpu_util = 0.0;
+  double cpu_busiest_thread = 0.0;
+  void sample_cpu(utime_t now);
   utime_t rebalance_time; //ensure a consistent view of load for rebalance
 
   // Dirfrags which are marked to be passed on to MDCache::[split|merge]_dir
@@ -177,11 +199,35 @@ private:
   // per-epoch state
   double          my_load, target_load;
 
+  // Load figures for beat_epoch, computed once at the heartbeat boundary
+  // and shared by every consumer in the epoch (heartbeats, ifbeats,
+  // rebalance), so they all see the same numbers and the full-auth
+  // subtrees are walked once per epoch rather than once per call.
+  struct load_snapshot_t {
+    int epoch = -1;
+    mds_load_t load;
+    double subtree_load = 0.0;     // sum of CDir::get_load over subtrees
+    map<dirfrag_t, double> dir_load;
+    vector<subtree_summary_t> top_subtrees;  // hottest first
+  };
+  load_snapshot_t snapshot;
+  const load_snapshot_t& get_snapshot(utime_t now);
+  double get_subtree_load(CDir *dir);
+
+  // subtree summaries: what we last advertised, and what peers advertised
+  map<dirfrag_t, subtree_summary_t> sent_subtrees;
+  int sent_subtrees_beat = -1;
+  map<mds_rank_t, map<dirfrag_t, subtree_summary_t> > peer_subtrees;
+  map<mds_rank_t, int> peer_subtrees_beat;
+  void prepare_subtree_summary(int *base, vector<subtree_summary_t>& changed,
+                               vector<dirfrag_t>& gone);
+  void handle_subtree_summary(mds_rank_t who, MHeartbeat *m);
+
   friend class CDir;
   friend class mds_load_t;
   ReqTracer req_tracer;
 public:
-  double calc_mds_load(mds_load_t load, bool auth = false);
+  double calc_mds_load(const mds_load_t& load, bool auth = false);
 };
 
 #endif
@@ -1267,6 +1267,9 @@ void MDLog::_replay_thread()
 {
   dout(10) << "_replay_thread start" << dendl;
 
+  // keep more journal objects in flight than we do while writing
+  journaler->set_prefetch_periods(g_conf->mds_log_replay_prefetch_periods);
+
   // loop
   int r = 0;
   while (1) {
@@ -1342,75 +1345,57 @@ void MDLog::_replay_thread()
     
     assert(journaler->is_readable() || mds->is_daemon_stopping());
     
-    // read it
-    uint64_t pos = journaler->get_read_pos();
-    bufferlist bl;
-    bool r = journaler->try_read_entry(bl);
-    if (!r && journaler->get_error())
+    // read whatever is already buffered, up to a batch
+    vector<replay_entry_t> batch;
+    size_t max_batch = MAX(1, g_conf->mds_log_replay_batch);
+    while (batch.size() < max_batch && journaler->is_readable()) {
+      replay_entry_t e;
+      e.pos = journaler->get_read_pos();
+      if (!journaler->try_read_entry(e.bl))
+	break;
+      e.end = journaler->get_read_pos();
+      batch.push_back(std::move(e));
+    }
+    if (batch.empty() && journaler->get_error())
       continue;
-    assert(r);
-    
-    // unpack event
-    LogEvent *le = LogEvent::decode(bl);
-    if (!le) {
-      dout(0) << "_replay " << pos << "~" << bl.length() << " / " << journaler->get_write_pos() 
+    assert(!batch.empty());
+
+    // unpack events
+    for (auto& e : batch)
+      e.le = LogEvent::decode(e.bl);
+
+    size_t i = 0;
+    while (i < batch.size()) {
+      {
+        Mutex::Locker l(mds->mds_lock);
+        if (mds->is_daemon_stopping()) {
+	  for (; i < batch.size(); ++i)
+	    delete batch[i].le;
+          return;
+        }
+	// apply everything up to the next undecodable event
+	for (; i < batch.size() && batch[i].le; ++i)
+	  _replay_one(batch[i]);
+      }
+      if (i == batch.size())
+	break;
+
+      replay_entry_t& e = batch[i++];
+      dout(0) << "_replay " << e.pos << "~" << e.bl.length() << " / " << journaler->get_write_pos() 
 	      << " -- unable to decode event" << dendl;
       dout(0) << "dump of unknown or corrupt event:\n";
-      bl.hexdump(*_dout);
+      e.bl.hexdump(*_dout);
       *_dout << dendl;
 
-      mds->clog->error() << "corrupt journal event at " << pos << "~"
-                         << bl.length() << " / "
+      mds->clog->error() << "corrupt journal event at " << e.pos << "~"
+                         << e.bl.length() << " / "
                          << journaler->get_write_pos();
-      if (g_conf->mds_log_skip_corrupt_events) {
-        continue;
-      } else {
+      if (!g_conf->mds_log_skip_corrupt_events) {
         mds->damaged_unlocked();
         ceph_abort();  // Should be unreachable because damaged() calls
                     // respawn()
       }
-
     }
-    le->set_start_off(pos);
-
-    // new segment?
-    if (le->get_type() == EVENT_SUBTREEMAP ||
-	le->get_type() == EVENT_RESETJOURNAL) {
-      ESubtreeMap *sle = dynamic_cast<ESubtreeMap*>(le);
-      if (sle && sle->event_seq > 0)
-	event_seq = sle->event_seq;
-      else
-	event_seq = pos;
-      segments[event_seq] = new LogSegment(event_seq, pos);
-      logger->set(l_mdl_seg, segments.size());
-    } else {
-      event_seq++;
-    }
-
-    // have we seen an import map yet?
-    if (segments.empty()) {
-      dout(10) << "_replay " << pos << "~" << bl.length() << " / " << journaler->get_write_pos() 
-	       << " " << le->get_stamp() << " -- waiting for subtree_map.  (skipping " << *le << ")" << dendl;
-    } else {
-      dout(10) << "_replay " << pos << "~" << bl.length() << " / " << journaler->get_write_pos() 
-	       << " " << le->get_stamp() << ": " << *le << dendl;
-      le->_segment = get_current_segment();    // replay may need this
-      le->_segment->num_events++;
-      le->_segment->end = journaler->get_read_pos();
-      num_events++;
-
-      {
-        Mutex::Locker l(mds->mds_lock);
-        if (mds->is_daemon_stopping()) {
-          return;
-        }
-        logger->inc(l_mdl_replayed);
-        le->replay(mds);
-      }
-    }
-    delete le;
-
-    logger->set(l_mdl_rdpos, pos);
   }
 
   // done!
@@ -1423,6 +1408,7 @@ void MDLog::_replay_thread()
   }
 
   safe_pos = journaler->get_write_safe_pos();
+  journaler->set_prefetch_periods(g_conf->journaler_prefetch_periods);
 
   dout(10) << "_replay_thread kicking waiters" << dendl;
   {
@@ -1436,6 +1422,47 @@ void MDLog::_replay_thread()
   dout(10) << "_replay_thread finish" << dendl;
 }
 
+void MDLog::_replay_one(replay_entry_t& e)
+{
+  LogEvent *le = e.le;
+  uint64_t pos = e.pos;
+  le->set_start_off(pos);
+
+  // new segment?
+  if (le->get_type() == EVENT_SUBTREEMAP ||
+      le->get_type() == EVENT_RESETJOURNAL) {
+    ESubtreeMap *sle = dynamic_cast<ESubtreeMap*>(le);
+    if (sle && sle->event_seq > 0)
+      event_seq = sle->event_seq;
+    else
+      event_seq = pos;
+    segments[event_seq] = new LogSegment(event_seq, pos);
+    logger->set(l_mdl_seg, segments.size());
+  } else {
+    event_seq++;
+  }
+
+  // have we seen an import map yet?
+  if (segments.empty()) {
+    dout(10) << "_replay " << pos << "~" << e.bl.length() << " / " << journaler->get_write_pos() 
+	     << " " << le->get_stamp() << " -- waiting for subtree_map.  (skipping " << *le << ")" << dendl;
+  } else {
+    dout(10) << "_replay " << pos << "~" << e.bl.length() << " / " << journaler->get_write_pos() 
+	     << " " << le->get_stamp() << ": " << *le << dendl;
+    le->_segment = get_current_segment();    // replay may need this
+    le->_segment->num_events++;
+    le->_segment->end = e.end;
+    num_events++;
+
+    logger->inc(l_mdl_replayed);
+    le->replay(mds);
+  }
+  delete le;
+  e.le = nullptr;
+
+  logger->set(l_mdl_rdpos, pos);
+}
+
 void MDLog::standby_trim_segments()
 {
   dout(10) << "standby_trim_segments" << dendl;
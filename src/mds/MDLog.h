@@ -104,6 +104,16 @@ protected:
   void _replay();         // old way
   void _replay_thread();  // new way
 
+  // raw journal entries read in one go, then decoded and applied in
+  // order under a single mds_lock acquisition
+  struct replay_entry_t {
+    uint64_t pos = 0;
+    uint64_t end = 0;
+    bufferlist bl;
+    LogEvent *le = nullptr;
+  };
+  void _replay_one(replay_entry_t& e);
+
   // Journal recovery/rewrite logic
   class RecoveryThread : public Thread {
     MDLog *log;
@@ -2628,6 +2628,12 @@ void MDSRank::create_logger()
     mds_plb.add_u64_counter(
       l_mds_imported_inodes, "imported_inodes", "Imported inodes", "imi",
       PerfCountersBuilder::PRIO_INTERESTING);
+    mds_plb.add_u64_counter(l_mds_scrub_inodes, "scrub_inodes", "Inodes scrubbed");
+    mds_plb.add_u64_counter(l_mds_scrub_dirfrags, "scrub_dirfrags", "Dirfrags scrubbed");
+    mds_plb.add_time_avg(l_mds_scrub_latency, "scrub_latency", "Inode scrub latency");
+    mds_plb.add_u64(l_mds_scrub_in_progress, "scrub_in_progress", "Scrub ops in progress");
+    mds_plb.add_u64(l_mds_scrub_ops_limit, "scrub_ops_limit", "Current scrub op limit");
+    mds_plb.add_u64(l_mds_scrub_stack, "scrub_stack", "Inodes waiting on the scrub stack");
     logger = mds_plb.create_perf_counters();
     g_ceph_context->get_perfcounters_collection()->add(logger);
   }
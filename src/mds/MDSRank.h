@@ -71,6 +71,12 @@ enum {
   l_mds_exported_inodes,
   l_mds_imported,
   l_mds_imported_inodes,
+  l_mds_scrub_inodes,
+  l_mds_scrub_dirfrags,
+  l_mds_scrub_latency,
+  l_mds_scrub_in_progress,
+  l_mds_scrub_ops_limit,
+  l_mds_scrub_stack,
   l_mds_last,
 };
 
@@ -290,6 +296,9 @@ class MDSRank {
 
     void create_logger();
   public:
+    uint64_t get_dispatch_queue_len() const {
+      return messenger->get_dispatch_queue_len();
+    }
 
     void queue_waiter(MDSInternalContextBase *c) {
       finished_queue.push_back(c);
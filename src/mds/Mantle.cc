@@ -44,46 +44,287 @@ static int dout_wrapper(lua_State *L)
   return 0;
 }
 
-int Mantle::balance(boost::string_view script,
-                    mds_rank_t whoami,
-                    const std::vector<std::map<std::string, double>> &metrics,
-                    std::map<mds_rank_t, double> &my_targets)
+/*
+ * Iterator behind the "subtrees" global: each auth subtree is described
+ * (and its path, load and size computed) only when the policy walks to
+ * it.  Indexes are 1-based like any Lua array and are what the policy
+ * hands back in its decision.  Upvalues are the Mantle and the
+ * generation of the balance() call the iterator belongs to.
+ */
+int Mantle::subtree_next(lua_State *L)
+{
+  Mantle *m = static_cast<Mantle*>(lua_touserdata(L, lua_upvalueindex(1)));
+  if (lua_tointeger(L, lua_upvalueindex(2)) != m->subtree_gen)
+    return luaL_error(L, "subtrees() iterator used outside its balancer tick");
+
+  lua_Integer i = luaL_checkinteger(L, 2) + 1;
+  if (i < 1 || i > (lua_Integer)m->subtrees.size())
+    return 0;
+
+  mantle_subtree_t &st = m->subtrees[i-1];
+  if (!st.filled) {
+    m->subtree_fill(i-1, st);
+    st.filled = true;
+  }
+  lua_pushinteger(L, i);
+  lua_createtable(L, 0, 8);
+  lua_pushinteger(L, (lua_Integer)st.dirfrag.ino.val);
+  lua_setfield(L, -2, "ino");
+  lua_pushinteger(L, (lua_Integer)st.dirfrag.frag.value());
+  lua_setfield(L, -2, "frag");
+  lua_pushinteger(L, (lua_Integer)st.dirfrag.frag.bits());
+  lua_setfield(L, -2, "frag_bits");
+  lua_pushstring(L, st.path.c_str());
+  lua_setfield(L, -2, "path");
+  lua_pushnumber(L, st.load);
+  lua_setfield(L, -2, "load");
+  lua_pushnumber(L, st.pot_auth);
+  lua_setfield(L, -2, "pot_auth");
+  lua_pushinteger(L, st.new_hit);
+  lua_setfield(L, -2, "new_hit");
+  lua_pushinteger(L, st.old_hit);
+  lua_setfield(L, -2, "old_hit");
+  lua_pushinteger(L, st.size);
+  lua_setfield(L, -2, "size");
+  return 2;
+}
+
+int Mantle::subtrees_wrapper(lua_State *L)
+{
+  Mantle *m = static_cast<Mantle*>(lua_touserdata(L, lua_upvalueindex(1)));
+  if (lua_tointeger(L, lua_upvalueindex(2)) != m->subtree_gen)
+    return luaL_error(L, "subtrees() used outside its balancer tick");
+
+  lua_pushvalue(L, lua_upvalueindex(1));
+  lua_pushvalue(L, lua_upvalueindex(2));
+  lua_pushcclosure(L, subtree_next, 2);
+  lua_pushnil(L);
+  lua_pushinteger(L, 0);
+  return 3;
+}
+
+int Mantle::load(boost::string_view script, const std::string &v)
 {
   lua_settop(L, 0); /* clear the stack */
 
-  /* load the balancer */
-  if (luaL_loadstring(L, script.data())) {
+  /* compile the balancer; keep the old chunk if the new one is broken */
+  if (luaL_loadbuffer(L, script.data(), script.length(), "balancer")) {
     mantle_dout(0) << "WARNING: mantle could not load balancer: "
             << lua_tostring(L, -1) << mantle_dendl;
+    lua_settop(L, 0);
     return -EINVAL;
   }
 
-  /* tell the balancer which mds is making the decision */
-  lua_pushinteger(L, (lua_Integer)whoami);
-  lua_setglobal(L, "whoami");
+  luaL_unref(L, LUA_REGISTRYINDEX, chunk_ref);
+  chunk_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+  version = v;
+  mantle_dout(10) << "cached balancer version " << version << mantle_dendl;
+  return 0;
+}
 
-  /* global mds metrics to hold all dictionaries */
-  lua_newtable(L);
+/*
+ * Update the global mds table in place: the per-rank tables are reused
+ * across calls and only their values are overwritten.
+ */
+void Mantle::set_metrics(const std::vector<std::map<std::string, double>> &metrics)
+{
+  if (lua_getglobal(L, "mds") != LUA_TTABLE) {
+    lua_pop(L, 1);
+    lua_newtable(L);
+    lua_pushvalue(L, -1);
+    lua_setglobal(L, "mds");
+  }
 
   /* push name of mds (i) and its metrics onto Lua stack */
   for (size_t i=0; i < metrics.size(); i++) {
-    lua_newtable(L);
+    if (lua_geti(L, -1, i) != LUA_TTABLE) {
+      lua_pop(L, 1);
+      lua_newtable(L);
+      lua_pushvalue(L, -1);
+      /* in global mds table at stack[-3], set k=i to v=stack[-1] */
+      lua_seti(L, -3, i);
+    }
 
     /* push values into this mds's table; setfield assigns key/pops val */
     for (const auto &it : metrics[i]) {
       lua_pushnumber(L, it.second);
       lua_setfield(L, -2, it.first.c_str());
     }
+    lua_pop(L, 1);
+  }
 
-    /* in global mds table at stack[-3], set k=stack[-1] to v=stack[-2] */
+  /* drop ranks left over from a bigger cluster */
+  for (lua_Integer i = metrics.size(); lua_geti(L, -1, i) != LUA_TNIL; i++) {
+    lua_pop(L, 1);
+    lua_pushnil(L);
     lua_seti(L, -2, i);
   }
+  lua_pop(L, 2);
+}
+
+int Mantle::balance(boost::string_view script,
+                    mds_rank_t whoami,
+                    const std::vector<std::map<std::string, double>> &metrics,
+                    std::map<mds_rank_t, double> &my_targets)
+{
+  int r = load(script, "");
+  if (r)
+    return r;
+  return balance(whoami, metrics, my_targets);
+}
 
-  /* set the name of the global mds table */
-  lua_setglobal(L, "mds");
+int Mantle::parse_targets(int idx, std::map<mds_rank_t, double> &my_targets)
+{
+  for (lua_pushnil(L); lua_next(L, idx); lua_pop(L, 1)) {
+    if (!lua_isinteger(L, -2) || !lua_isnumber(L, -1)) {
+      mantle_dout(0) << "WARNING: mantle script returned a malformed response" << mantle_dendl;
+      return -EINVAL;
+    }
+    mds_rank_t rank(lua_tointeger(L, -2));
+    my_targets[rank] = lua_tonumber(L, -1);
+  }
+  return 0;
+}
+
+/*
+ * Parse a response of the form
+ *   { targets = {[rank]=load,...},
+ *     exports = {{subtree=i, to=rank}, ...},
+ *     split   = {i | {subtree=i, bits=n}, ...},
+ *     merge   = {i, ...} }
+ * where every field is optional.  The response table is at the top of
+ * the stack.
+ */
+int Mantle::parse_decision(size_t nsubtrees, mantle_decision_t &decision)
+{
+  int resp = lua_gettop(L);
+  auto subtree_index = [this, nsubtrees](int idx, size_t *out) {
+    if (!lua_isinteger(L, idx))
+      return false;
+    lua_Integer i = lua_tointeger(L, idx);
+    if (i < 1 || i > (lua_Integer)nsubtrees)
+      return false;
+    *out = i - 1;
+    return true;
+  };
+
+  if (lua_getfield(L, resp, "targets") == LUA_TTABLE) {
+    if (parse_targets(lua_gettop(L), decision.targets))
+      return -EINVAL;
+  }
+  lua_settop(L, resp);
+
+  if (lua_getfield(L, resp, "exports") == LUA_TTABLE) {
+    for (lua_pushnil(L); lua_next(L, -2); lua_pop(L, 1)) {
+      size_t i;
+      bool ok = lua_istable(L, -1);
+      if (ok) {
+        lua_getfield(L, -1, "subtree");
+        lua_getfield(L, -2, "to");
+        ok = subtree_index(-2, &i) && lua_isinteger(L, -1);
+      }
+      if (!ok) {
+        mantle_dout(0) << "WARNING: mantle script returned a malformed export" << mantle_dendl;
+        return -EINVAL;
+      }
+      decision.exports.push_back(std::make_pair(i, mds_rank_t(lua_tointeger(L, -1))));
+      lua_pop(L, 2);
+    }
+  }
+  lua_settop(L, resp);
+
+  if (lua_getfield(L, resp, "split") == LUA_TTABLE) {
+    for (lua_pushnil(L); lua_next(L, -2); lua_pop(L, 1)) {
+      size_t i;
+      int bits = 0;
+      if (lua_istable(L, -1)) {
+        lua_getfield(L, -1, "subtree");
+        bool ok = subtree_index(-1, &i);
+        if (lua_getfield(L, -2, "bits") == LUA_TNUMBER)
+          bits = lua_tointeger(L, -1);
+        lua_pop(L, 2);
+        if (!ok || bits < 0 || bits > max_split_bits) {
+          mantle_dout(0) << "WARNING: mantle script returned a malformed split" << mantle_dendl;
+          return -EINVAL;
+        }
+      } else if (!subtree_index(-1, &i)) {
+        mantle_dout(0) << "WARNING: mantle script returned a malformed split" << mantle_dendl;
+        return -EINVAL;
+      }
+      decision.splits.push_back(std::make_pair(i, bits));
+    }
+  }
+  lua_settop(L, resp);
+
+  if (lua_getfield(L, resp, "merge") == LUA_TTABLE) {
+    for (lua_pushnil(L); lua_next(L, -2); lua_pop(L, 1)) {
+      size_t i;
+      if (!subtree_index(-1, &i)) {
+        mantle_dout(0) << "WARNING: mantle script returned a malformed merge" << mantle_dendl;
+        return -EINVAL;
+      }
+      decision.merges.push_back(i);
+    }
+  }
+  lua_settop(L, resp);
+  return 0;
+}
+
+int Mantle::balance(mds_rank_t whoami,
+                    const std::vector<std::map<std::string, double>> &metrics,
+                    std::map<mds_rank_t, double> &my_targets)
+{
+  mantle_decision_t decision;
+  int r = balance(whoami, metrics, std::vector<mantle_subtree_t>(),
+                  mantle_subtree_fill_t(), decision);
+  my_targets.swap(decision.targets);
+  return r;
+}
+
+int Mantle::balance(mds_rank_t whoami,
+                    const std::vector<std::map<std::string, double>> &metrics,
+                    std::vector<mantle_subtree_t> auth_subtrees,
+                    const mantle_subtree_fill_t &fill,
+                    mantle_decision_t &decision)
+{
+  lua_settop(L, 0); /* clear the stack */
+
+  if (chunk_ref == LUA_NOREF) {
+    mantle_dout(0) << "WARNING: mantle has no balancer loaded" << mantle_dendl;
+    return -EINVAL;
+  }
+
+  /* tell the balancer which mds is making the decision */
+  lua_pushinteger(L, (lua_Integer)whoami);
+  lua_setglobal(L, "whoami");
+
+  /* global mds metrics to hold all dictionaries */
+  set_metrics(metrics);
+
+  /* iterator over this mds's auth subtrees, valid for this call only */
+  subtrees.swap(auth_subtrees);
+  subtree_fill = fill;
+  lua_pushlightuserdata(L, this);
+  lua_pushinteger(L, subtree_gen);
+  lua_pushcclosure(L, subtrees_wrapper, 2);
+  lua_setglobal(L, "subtrees");
+
+  /* fetch the compiled balancer */
+  lua_rawgeti(L, LUA_REGISTRYINDEX, chunk_ref);
 
   assert(lua_gettop(L) == 1);
-  if (lua_pcall(L, 0, 1, 0) != LUA_OK) {
+  int r = lua_pcall(L, 0, 1, 0);
+
+  /* retire every iterator handed out during this call, including ones
+   * the policy stashed away, before what they point at goes */
+  subtree_gen++;
+  subtree_fill = mantle_subtree_fill_t();
+  size_t nsubtrees = subtrees.size();
+  subtrees.clear();
+  lua_pushnil(L);
+  lua_setglobal(L, "subtrees");
+
+  if (r != LUA_OK) {
     mantle_dout(0) << "WARNING: mantle could not execute script: "
             << lua_tostring(L, -1) << mantle_dendl;
     return -EINVAL;
@@ -95,17 +336,18 @@ int Mantle::balance(boost::string_view script,
     return -EINVAL;
   }
 
-  /* fill in return value */
-  for (lua_pushnil(L); lua_next(L, -2); lua_pop(L, 1)) {
-    if (!lua_isinteger(L, -2) || !lua_isnumber(L, -1)) {
-      mantle_dout(0) << "WARNING: mantle script returned a malformed response" << mantle_dendl;
-      return -EINVAL;
-    }
-    mds_rank_t rank(lua_tointeger(L, -2));
-    my_targets[rank] = lua_tonumber(L, -1);
+  /* a table with any of the named fields is a full decision, anything
+   * else is the classic {[rank]=load} table */
+  bool named = false;
+  for (const char *field : {"targets", "exports", "split", "merge"}) {
+    named |= (lua_getfield(L, -1, field) != LUA_TNIL);
+    lua_pop(L, 1);
   }
+  if (named)
+    return parse_decision(nsubtrees, decision);
 
-  return 0;
+  /* fill in return value */
+  return parse_targets(lua_gettop(L), decision.targets);
 }
 
 Mantle::Mantle (void)
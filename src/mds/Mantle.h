@@ -18,23 +18,92 @@
 #include <boost/utility/string_view.hpp>
 
 #include <lua.hpp>
+#include <functional>
 #include <vector>
 #include <map>
 #include <string>
 
 #include "mdstypes.h"
 
+/* An auth subtree as seen by a balancer policy.  Only dirfrag is set up
+ * front; the rest is filled in the first time the policy reaches it. */
+struct mantle_subtree_t {
+  dirfrag_t dirfrag;
+  bool filled = false;
+  std::string path;
+  double load = 0.0;       // CDir::get_load()
+  double pot_auth = 0.0;   // potential load of the auth subtree
+  int new_hit = 0;         // last epoch's hits on new/old inodes
+  int old_hit = 0;
+  int size = 0;            // dentries in the auth subtree
+};
+
+/* fills in subtree i for the policy */
+typedef std::function<void(size_t, mantle_subtree_t&)> mantle_subtree_fill_t;
+
+/* What a policy may ask for besides per-rank target loads. */
+struct mantle_decision_t {
+  std::map<mds_rank_t, double> targets;
+  std::vector<std::pair<size_t, mds_rank_t> > exports;  // subtree index -> rank
+  std::vector<std::pair<size_t, int> > splits;          // subtree index -> bits (0: default)
+  std::vector<size_t> merges;                           // subtree index
+  bool has_explicit() const {
+    return !exports.empty() || !splits.empty() || !merges.empty();
+  }
+};
+
 class Mantle {
   public:
     Mantle();
     ~Mantle() { if (L) lua_close(L); }
+
+    /* Compile the policy once and keep the chunk in the Lua registry; the
+     * Lua state (and any globals the policy keeps in it) lives as long as
+     * this object, so repeated balance() calls skip the parser. */
+    int load(boost::string_view script, const std::string &version);
+    bool is_loaded(const std::string &v) const {
+      return chunk_ref != LUA_NOREF && version == v;
+    }
+
+    /* run the cached chunk */
+    int balance(mds_rank_t whoami,
+                const std::vector <std::map<std::string, double>> &metrics,
+                std::map<mds_rank_t,double> &my_targets);
+    /* run the cached chunk with the subtree iterator available; the policy
+     * may return explicit exports and split/merge hints.  fill is only
+     * called during this call, for the subtrees the policy walks. */
+    int balance(mds_rank_t whoami,
+                const std::vector <std::map<std::string, double>> &metrics,
+                std::vector<mantle_subtree_t> auth_subtrees,
+                const mantle_subtree_fill_t &fill,
+                mantle_decision_t &decision);
+    /* compile and run in one go */
     int balance(boost::string_view script,
                 mds_rank_t whoami,
                 const std::vector <std::map<std::string, double>> &metrics,
                 std::map<mds_rank_t,double> &my_targets);
 
+    /* largest split a policy may ask for */
+    static const int max_split_bits = 8;
+
   protected:
+    static int subtree_next(lua_State *L);
+    static int subtrees_wrapper(lua_State *L);
+
+    void set_metrics(const std::vector <std::map<std::string, double>> &metrics);
+    int parse_targets(int idx, std::map<mds_rank_t,double> &my_targets);
+    int parse_decision(size_t nsubtrees, mantle_decision_t &decision);
+
     lua_State *L;
+    int chunk_ref = LUA_NOREF;
+    std::string version;
+
+    /* what the subtrees() iterator walks.  Iterators capture the
+     * generation they were made in and refuse to run once balance()
+     * has returned, since the policy may keep one in a global. */
+    std::vector<mantle_subtree_t> subtrees;
+    mantle_subtree_fill_t subtree_fill;
+    lua_Integer subtree_gen = 0;
 };
 
 #endif
@@ -36,6 +36,7 @@
 #include "msg/Messenger.h"
 
 #include "messages/MClientCaps.h"
+#include "messages/MClientAuthHint.h"
 
 #include "messages/MExportDirDiscover.h"
 #include "messages/MExportDirDiscoverAck.h"
@@ -3325,6 +3326,47 @@ void Migrator::handle_export_finish(MExportDirFinish *m)
   m->put();
 }
 
+/*
+ * Tell the clients with caps in a freshly imported subtree that we now
+ * serve it, so their next lookups in it come straight here instead of
+ * being forwarded by the exporter.  Every such client learns about the
+ * subtree root; each also learns about the imported directories it holds
+ * caps on.
+ */
+void Migrator::import_send_auth_hints(CDir *dir, import_state_t& stat)
+{
+  if (!g_conf->mds_client_auth_hints)
+    return;
+
+  map<client_t, set<dirfrag_t> > hints;
+  for (auto p = stat.client_map.begin(); p != stat.client_map.end(); ++p)
+    hints[p->first].insert(dir->dirfrag());
+  for (auto p = stat.peer_exports.begin(); p != stat.peer_exports.end(); ++p) {
+    CInode *in = p->first;
+    if (!in->is_dir())
+      continue;
+    list<CDir*> dirs;
+    in->get_dirfrags(dirs);
+    for (auto q = p->second.begin(); q != p->second.end(); ++q) {
+      for (auto d : dirs) {
+	if (d->is_auth())
+	  hints[q->first].insert(d->dirfrag());
+      }
+    }
+  }
+
+  for (auto p = hints.begin(); p != hints.end(); ++p) {
+    Session *session = mds->sessionmap.get_session(entity_name_t::CLIENT(p->first.v));
+    if (!session || !session->info.client_metadata.count("auth_hints"))
+      continue;
+    MClientAuthHint *m = new MClientAuthHint(mds->get_nodeid());
+    m->dirfrags.assign(p->second.begin(), p->second.end());
+    dout(10) << "import_send_auth_hints " << p->second.size() << " dirfrags to "
+	     << session->info.inst.name << dendl;
+    mds->send_message_client_counted(m, session);
+  }
+}
+
 void Migrator::import_finish(CDir *dir, bool notify, bool last)
 {
   dout(7) << "import_finish on " << *dir << dendl;
@@ -3342,6 +3384,7 @@ void Migrator::import_finish(CDir *dir, bool notify, bool last)
   assert(g_conf->mds_kill_import_at != 9);
 
   if (it->second.state == IMPORT_ACKING) {
+    import_send_auth_hints(dir, it->second);
     for (map<CInode*, map<client_t,Capability::Export> >::iterator p = it->second.peer_exports.begin();
 	p != it->second.peer_exports.end();
 	++p) {
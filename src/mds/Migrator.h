@@ -367,6 +367,7 @@ public:
 
   void import_reverse(CDir *dir);
 
+  void import_send_auth_hints(CDir *dir, import_state_t& stat);
   void import_finish(CDir *dir, bool notify, bool last=true);
 
 private:
@@ -103,6 +103,7 @@ void PurgeQueue::create_logger()
   pcb.add_u64(l_pq_executing, "pq_executing", "Purge queue tasks in flight");
   pcb.add_u64_counter(l_pq_executed, "pq_executed", "Purge queue tasks executed", "purg",
       PerfCountersBuilder::PRIO_INTERESTING);
+  pcb.add_u64(l_pq_pending, "pq_pending", "Purge queue tasks read but waiting for their pool");
 
   logger.reset(pcb.create_perf_counters());
   g_ceph_context->get_perfcounters_collection()->add(logger.get());
@@ -315,33 +316,116 @@ uint32_t PurgeQueue::_calculate_ops(const PurgeItem &item) const
   return ops_required;
 }
 
+int64_t PurgeQueue::_item_pool(const PurgeItem &item) const
+{
+  if (item.action == PurgeItem::PURGE_DIR)
+    return metadata_pool;
+  return item.layout.pool_id;
+}
+
+uint64_t PurgeQueue::_shard_op_limit(const pool_shard_t &shard) const
+{
+  if (draining)
+    return max_purge_ops;
+  return MAX(1, uint64_t(shard.op_limit * shard.scale));
+}
+
+/*
+ * Additive increase while the pool keeps up, multiplicative decrease
+ * (at most once per target interval) when it does not: purging backs
+ * off as soon as the OSDs get busy with foreground I/O.
+ */
+void PurgeQueue::_adapt_shard(pool_shard_t &shard, double latency)
+{
+  const double target = cct->_conf->mds_purge_target_latency;
+  if (target <= 0)
+    return;
+
+  const double max_scale = MAX(1.0, cct->_conf->mds_purge_max_scale);
+  if (latency <= target) {
+    shard.scale = MIN(max_scale, shard.scale + 0.05);
+  } else {
+    utime_t now = ceph_clock_now();
+    if ((double)(now - shard.last_backoff) >= target) {
+      shard.scale = MAX(1.0 / max_scale, shard.scale * 0.7);
+      shard.last_backoff = now;
+    }
+  }
+}
+
 bool PurgeQueue::can_consume()
 {
+  const uint64_t pending = in_flight.size() - executing.size();
   dout(20) << ops_in_flight << "/" << max_purge_ops << " ops, "
-           << in_flight.size() << "/" << g_conf->mds_max_purge_files
-           << " files" << dendl;
+           << executing.size() << "/" << g_conf->mds_max_purge_files
+           << " files, " << pending << " pending" << dendl;
+
+  // Administrator has deliberately paused purging
+  if (cct->_conf->mds_max_purge_files == 0)
+    return false;
 
-  if (in_flight.size() == 0 && cct->_conf->mds_max_purge_files > 0) {
-    // Always permit consumption if nothing is in flight, so that the ops
+  // Read ahead so that every pool with budget has something to do
+  if (pending >= MAX(1, cct->_conf->mds_purge_queue_read_ahead)) {
+    dout(20) << "Throttling on read ahead " << pending << dendl;
+    return false;
+  }
+  return true;
+}
+
+bool PurgeQueue::can_execute(const pool_shard_t &shard)
+{
+  if (executing.empty() && cct->_conf->mds_max_purge_files > 0) {
+    // Always permit execution if nothing is in flight, so that the ops
     // limit can never be so low as to forbid all progress (unless
     // administrator has deliberately paused purging by setting max
     // purge files to zero).
     return true;
   }
 
-  if (ops_in_flight >= max_purge_ops) {
+  if (executing.size() >= cct->_conf->mds_max_purge_files) {
+    dout(20) << "Throttling on item limit " << executing.size()
+             << "/" << cct->_conf->mds_max_purge_files << dendl;
+    return false;
+  }
+
+  // the PG-derived budget bounds all pools together; a shard scaled
+  // up for a fast pool only borrows from it
+  if (max_purge_ops && ops_in_flight >= max_purge_ops) {
     dout(20) << "Throttling on op limit " << ops_in_flight << "/"
              << max_purge_ops << dendl;
     return false;
   }
 
-  if (in_flight.size() >= cct->_conf->mds_max_purge_files) {
-    dout(20) << "Throttling on item limit " << in_flight.size()
-             << "/" << cct->_conf->mds_max_purge_files << dendl;
+  const uint64_t limit = _shard_op_limit(shard);
+  if (shard.ops_in_flight >= limit) {
+    dout(20) << "Throttling on pool op limit " << shard.ops_in_flight
+             << "/" << limit << dendl;
     return false;
-  } else {
-    return true;
   }
+  return true;
+}
+
+void PurgeQueue::_dispatch()
+{
+  assert(lock.is_locked_by_me());
+
+  // round-robin over the pools, one item each per pass
+  bool progress = true;
+  while (progress) {
+    progress = false;
+    for (auto &p : shards) {
+      pool_shard_t &shard = p.second;
+      if (shard.pending.empty() || !can_execute(shard))
+        continue;
+      uint64_t expire_to = shard.pending.front();
+      shard.pending.pop_front();
+      dout(20) << " executing item (0x" << std::hex << in_flight[expire_to].ino
+               << std::dec << ") from pool " << p.first << dendl;
+      _execute_item(in_flight[expire_to], expire_to);
+      progress = true;
+    }
+  }
+  logger->set(l_pq_pending, in_flight.size() - executing.size());
 }
 
 bool PurgeQueue::_consume()
@@ -373,6 +457,7 @@ bool PurgeQueue::_consume()
         }));
       }
 
+      _dispatch();
       return could_consume;
     }
 
@@ -391,12 +476,20 @@ bool PurgeQueue::_consume()
            << journaler.get_read_pos() << dendl;
       on_error->complete(0);
     }
-    dout(20) << " executing item (0x" << std::hex << item.ino
-             << std::dec << ")" << dendl;
-    _execute_item(item, journaler.get_read_pos());
+    uint64_t expire_to = journaler.get_read_pos();
+    dout(20) << " queueing item (0x" << std::hex << item.ino
+             << std::dec << ") at 0x" << std::hex << expire_to << std::dec << dendl;
+    pool_shard_t &shard = shards[_item_pool(item)];
+    if (!shard.op_limit) {
+      auto l = pool_op_limits.find(_item_pool(item));
+      shard.op_limit = (l != pool_op_limits.end()) ? l->second : max_purge_ops;
+    }
+    in_flight[expire_to] = item;
+    shard.pending.push_back(expire_to);
   }
 
   dout(10) << " cannot consume right now" << dendl;
+  _dispatch();
 
   return could_consume;
 }
@@ -407,9 +500,12 @@ void PurgeQueue::_execute_item(
 {
   assert(lock.is_locked_by_me());
 
-  in_flight[expire_to] = item;
-  logger->set(l_pq_executing, in_flight.size());
-  ops_in_flight += _calculate_ops(item);
+  assert(in_flight.count(expire_to) == 1);
+  executing[expire_to] = ceph_clock_now();
+  logger->set(l_pq_executing, executing.size());
+  const uint32_t ops = _calculate_ops(item);
+  ops_in_flight += ops;
+  shards[_item_pool(item)].ops_in_flight += ops;
   logger->set(l_pq_executing_ops, ops_in_flight);
 
   SnapContext nullsnapc;
@@ -476,8 +572,12 @@ void PurgeQueue::_execute_item(
   } else {
     derr << "Invalid item (action=" << item.action << ") in purge queue, "
             "dropping it" << dendl;
+    ops_in_flight -= ops;
+    shards[_item_pool(item)].ops_in_flight -= ops;
+    logger->set(l_pq_executing_ops, ops_in_flight);
+    executing.erase(expire_to);
     in_flight.erase(expire_to);
-    logger->set(l_pq_executing, in_flight.size());
+    logger->set(l_pq_executing, executing.size());
     return;
   }
   assert(gather.has_subs());
@@ -524,14 +624,24 @@ void PurgeQueue::_execute_item_complete(
     dout(10) << "non-sequential completion, not expiring anything" << dendl;
   }
 
-  ops_in_flight -= _calculate_ops(iter->second);
+  const uint32_t ops = _calculate_ops(iter->second);
+  pool_shard_t &shard = shards[_item_pool(iter->second)];
+  ops_in_flight -= ops;
+  shard.ops_in_flight -= ops;
   logger->set(l_pq_executing_ops, ops_in_flight);
 
+  auto e = executing.find(expire_to);
+  assert(e != executing.end());
+  double latency = ceph_clock_now() - e->second;
+  _adapt_shard(shard, latency);
+  executing.erase(e);
+
   dout(10) << "completed item for ino 0x" << std::hex << iter->second.ino
-           << std::dec << dendl;
+           << std::dec << " in " << latency << "s, pool scale now "
+           << shard.scale << dendl;
 
   in_flight.erase(iter);
-  logger->set(l_pq_executing, in_flight.size());
+  logger->set(l_pq_executing, executing.size());
   dout(10) << "in_flight.size() now " << in_flight.size() << dendl;
 
   logger->inc(l_pq_executed);
@@ -542,6 +652,7 @@ void PurgeQueue::update_op_limit(const MDSMap &mds_map)
   Mutex::Locker l(lock);
 
   uint64_t pg_count = 0;
+  std::map<int64_t, uint64_t> pool_pgs;
   objecter->with_osdmap([&](const OSDMap& o) {
     // Number of PGs across all data pools
     const std::vector<int64_t> &data_pools = mds_map.get_data_pools();
@@ -554,6 +665,7 @@ void PurgeQueue::update_op_limit(const MDSMap &mds_map)
         continue;
       }
       pg_count += o.get_pg_num(dp);
+      pool_pgs[dp] = o.get_pg_num(dp);
     }
   });
 
@@ -566,6 +678,27 @@ void PurgeQueue::update_op_limit(const MDSMap &mds_map)
   if (cct->_conf->mds_max_purge_ops) {
     max_purge_ops = MIN(max_purge_ops, cct->_conf->mds_max_purge_ops);
   }
+
+  // Each pool's share of that, by its own PG count
+  pool_op_limits.clear();
+  for (const auto &p : pool_pgs) {
+    uint64_t limit = uint64_t(((double)p.second / (double)mds_map.get_max_mds()) *
+                              cct->_conf->mds_max_purge_ops_per_pg);
+    pool_op_limits[p.first] = MIN(limit, max_purge_ops);
+  }
+  for (auto &p : shards) {
+    auto l = pool_op_limits.find(p.first);
+    p.second.op_limit = (l != pool_op_limits.end()) ? l->second : max_purge_ops;
+  }
+
+  // read-ahead items held back by the old limits: start them now
+  // rather than at the next completion or push
+  if (in_flight.size() > executing.size()) {
+    finisher.queue(new FunctionContext([this](int r){
+      Mutex::Locker l(lock);
+      _consume();
+    }));
+  }
 }
 
 void PurgeQueue::handle_conf_change(const struct md_config_t *conf,
@@ -578,9 +711,10 @@ void PurgeQueue::handle_conf_change(const struct md_config_t *conf,
   } else if (changed.count("mds_max_purge_files")) {
     Mutex::Locker l(lock);
 
-    if (in_flight.empty()) {
+    if (in_flight.empty() || in_flight.size() > executing.size()) {
       // We might have gone from zero to a finite limit, so
-      // might need to kick off consume.
+      // might need to kick off consume, either to read more or to
+      // start items already read ahead.
       dout(4) << "maybe start work again (max_purge_files="
               << conf->mds_max_purge_files << dendl;
       finisher.queue(new FunctionContext([this](int r){
@@ -624,7 +758,7 @@ bool PurgeQueue::drain(
 
   *progress = drain_initial - bytes_remaining;
   *progress_total = drain_initial;
-  *in_flight_count = in_flight.size();
+  *in_flight_count = executing.size();
 
   return false;
 }
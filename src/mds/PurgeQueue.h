@@ -60,6 +60,7 @@ enum {
   l_pq_executing_ops,
   l_pq_executing,
   l_pq_executed,
+  l_pq_pending,
   l_pq_last
 };
 
@@ -92,18 +93,48 @@ protected:
 
   Context *on_error;
 
-  // Map of Journaler offset to PurgeItem
+  // Map of Journaler offset to PurgeItem, for every item read from the
+  // journal that has not finished yet (pending or executing)
   std::map<uint64_t, PurgeItem> in_flight;
 
+  // Journaler offsets of the items currently executing, and when they
+  // started
+  std::map<uint64_t, utime_t> executing;
+
   // Throttled allowances
   uint64_t ops_in_flight;
 
   // Dynamic op limit per MDS based on PG count
   uint64_t max_purge_ops;
 
+  /*
+   * Items read from the journal are queued per pool, so that a pool
+   * whose OSDs are slow or small does not hold up purging elsewhere.
+   * Each pool gets its share of max_purge_ops by PG count, scaled up
+   * while its purges complete within mds_purge_target_latency and
+   * backed off when they do not.
+   */
+  struct pool_shard_t {
+    std::deque<uint64_t> pending;
+    uint64_t ops_in_flight = 0;
+    uint64_t op_limit = 0;
+    double scale = 1.0;
+    utime_t last_backoff;
+  };
+  std::map<int64_t, pool_shard_t> shards;
+  std::map<int64_t, uint64_t> pool_op_limits;
+
+  int64_t _item_pool(const PurgeItem &item) const;
+  uint64_t _shard_op_limit(const pool_shard_t &shard) const;
+  void _adapt_shard(pool_shard_t &shard, double latency);
+
   uint32_t _calculate_ops(const PurgeItem &item) const;
 
   bool can_consume();
+  bool can_execute(const pool_shard_t &shard);
+
+  // start executing pending items while their shards have budget
+  void _dispatch();
 
   // How many bytes were remaining when drain() was first called,
   // used for indicating progress.
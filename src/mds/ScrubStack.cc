@@ -79,17 +79,60 @@ void ScrubStack::enqueue_inode(CInode *in, ScrubHeaderRef& header,
   kick_off_scrubs();
 }
 
+int ScrubStack::scrub_ops_limit() const
+{
+  int limit = MAX(1, int(g_conf->mds_max_scrub_ops_in_progress * ops_scale));
+
+  // client requests queueing up: leave the CPU to them
+  MDSRank *mds = mdcache->mds;
+  if (g_conf->mds_scrub_busy_queue_len > 0 &&
+      mds->get_dispatch_queue_len() >
+        (uint64_t)g_conf->mds_scrub_busy_queue_len)
+    limit = 1;
+  return limit;
+}
+
+void ScrubStack::note_validated(const utime_t &latency)
+{
+  MDSRank *mds = mdcache->mds;
+  if (mds->logger) {
+    mds->logger->inc(l_mds_scrub_inodes);
+    mds->logger->tinc(l_mds_scrub_latency, latency);
+  }
+
+  const double target = g_conf->mds_scrub_target_latency;
+  if (target <= 0 || g_conf->mds_max_scrub_ops_in_progress <= 0)
+    return;
+  const double min_scale = 1.0 / g_conf->mds_max_scrub_ops_in_progress;
+  if ((double)latency > target)
+    ops_scale = MAX(min_scale, ops_scale * 0.7);
+  else
+    ops_scale = MIN(1.0, ops_scale + 0.05);
+}
+
 void ScrubStack::kick_off_scrubs()
 {
   dout(20) << __func__ << " entering with " << scrubs_in_progress << " in "
               "progress and " << stack_size << " in the stack" << dendl;
   bool can_continue = true;
+  // directories that are waiting (on a fetch, or on their children) don't
+  // stop us from working on what is below them on the stack, i.e. their
+  // siblings' subtrees, until this many are waiting at once.  After a
+  // sibling makes progress we start over from the top of the stack, so
+  // remember who is waiting: looking at them again would only count
+  // them twice and queue another fetch.
+  std::set<CInode*> blocked;
+  const size_t max_blocked = MAX(1, g_conf->mds_scrub_parallel_dirs);
+  const int limit = scrub_ops_limit();
   elist<CInode*>::iterator i = inode_stack.begin();
-  while (g_conf->mds_max_scrub_ops_in_progress > scrubs_in_progress &&
+  while (limit > scrubs_in_progress &&
       can_continue && !i.end()) {
     CInode *curi = *i;
     ++i; // we have our reference, push iterator forward
 
+    if (blocked.count(curi))
+      continue;
+
     dout(20) << __func__ << " examining " << *curi << dendl;
 
     if (!curi->is_dir()) {
@@ -118,9 +161,18 @@ void ScrubStack::kick_off_scrubs()
         dout(20) << __func__ << " dir no-op" << dendl;
       }
 
-      can_continue = progress || terminal || completed;
+      if (!(progress || terminal || completed))
+        blocked.insert(curi);
+      can_continue = blocked.size() < max_blocked;
     }
   }
+
+  MDSRank *mds = mdcache->mds;
+  if (mds->logger) {
+    mds->logger->set(l_mds_scrub_in_progress, scrubs_in_progress);
+    mds->logger->set(l_mds_scrub_ops_limit, limit);
+    mds->logger->set(l_mds_scrub_stack, stack_size);
+  }
 }
 
 void ScrubStack::scrub_dir_inode(CInode *in,
@@ -161,7 +213,7 @@ void ScrubStack::scrub_dir_inode(CInode *in,
 	     << " scrubbing cdirs" << dendl;
 
     list<CDir*>::iterator i = scrubbing_cdirs.begin();
-    while (g_conf->mds_max_scrub_ops_in_progress > scrubs_in_progress) {
+    while (scrub_ops_limit() > scrubs_in_progress) {
       // select next CDir
       CDir *cur_dir = NULL;
       if (i != scrubbing_cdirs.end()) {
@@ -252,13 +304,16 @@ class C_InodeValidated : public MDSInternalContext
     ScrubStack *stack;
     CInode::validated_data result;
     CInode *target;
+    utime_t start;
 
     C_InodeValidated(MDSRank *mds, ScrubStack *stack_, CInode *target_)
-      : MDSInternalContext(mds), stack(stack_), target(target_)
+      : MDSInternalContext(mds), stack(stack_), target(target_),
+        start(ceph_clock_now())
     {}
 
     void finish(int r) override
     {
+      stack->note_validated(ceph_clock_now() - start);
       stack->_validate_inode_done(target, r, result);
     }
 };
@@ -338,6 +393,8 @@ void ScrubStack::scrub_dirfrag(CDir *dir,
         dout(20) << __func__ << " dirfrag done: " << *dir << dendl;
         // FIXME: greg: What's the diff meant to be between done and terminal
 	dir->scrub_finished();
+	if (mdcache->mds->logger)
+	  mdcache->mds->logger->inc(l_mds_scrub_dirfrags);
         *done = true;
         *is_terminal = true;
       } else {
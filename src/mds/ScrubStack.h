@@ -37,6 +37,10 @@ protected:
   int scrubs_in_progress;
   ScrubStack *scrubstack; // hack for dout
   int stack_size;
+  /// fraction of mds_max_scrub_ops_in_progress we currently allow,
+  /// lowered while validation reads come back slower than
+  /// mds_scrub_target_latency
+  double ops_scale;
 
   class C_KickOffScrubs : public MDSInternalContext {
     ScrubStack *stack;
@@ -59,6 +63,7 @@ public:
     scrubs_in_progress(0),
     scrubstack(this),
     stack_size(0),
+    ops_scale(1.0),
     scrub_kick(mdc, this),
     mdcache(mdc) {}
   ~ScrubStack() {
@@ -99,6 +104,14 @@ private:
    * state of the stack.
    */
   void kick_off_scrubs();
+  /**
+   * How many scrub ops we may have in flight right now.
+   */
+  int scrub_ops_limit() const;
+  /**
+   * Account a finished inode validation and adapt the op limit.
+   */
+  void note_validated(const utime_t &latency);
   /**
    * Push a indoe on top of the stack.
    */
@@ -361,11 +361,30 @@ void SessionMap::save(MDSInternalContextBase *onsave, version_t needv)
 
   commit_waiters[version].push_back(onsave);
 
+  if (committing > committed) {
+    /* A write is already in flight.  Rather than racing another full
+     * write of the dirty set behind it, coalesce every save requested
+     * meanwhile (e.g. several log segments expiring at once) into a
+     * single write issued when the current one completes. */
+    dout(10) << __func__ << ": write of v" << committing
+	     << " in flight, queueing v" << version << dendl;
+    save_queued = true;
+    return;
+  }
+
+  _save();
+}
+
+void SessionMap::_save()
+{
   committing = version;
   SnapContext snapc;
   object_t oid = get_object_name();
   object_locator_t oloc(mds->mdsmap->get_metadata_pool());
 
+  /* One OMAP transaction for the whole dirty set and the header: the
+   * object is a checkpoint, and a partial write would leave new session
+   * keys under an old header version. */
   ObjectOperation op;
 
   /* Compose OSD OMAP transaction for full write */
@@ -430,10 +449,11 @@ void SessionMap::save(MDSInternalContextBase *onsave, version_t needv)
   dirty_sessions.clear();
   null_sessions.clear();
 
+  dout(10) << __func__ << ": writing v" << committing << dendl;
   mds->objecter->mutate(oid, oloc, op, snapc,
 			ceph::real_clock::now(),
 			0,
-			new C_OnFinisher(new C_IO_SM_Save(this, version),
+			new C_OnFinisher(new C_IO_SM_Save(this, committing),
 					 mds->finisher));
 }
 
@@ -442,8 +462,20 @@ void SessionMap::_save_finish(version_t v)
   dout(10) << "_save_finish v" << v << dendl;
   committed = v;
 
-  finish_contexts(g_ceph_context, commit_waiters[v]);
-  commit_waiters.erase(v);
+  // a write of v also covers any waiters queued on older versions
+  list<MDSInternalContextBase*> ls;
+  while (!commit_waiters.empty() && commit_waiters.begin()->first <= v) {
+    ls.splice(ls.end(), commit_waiters.begin()->second);
+    commit_waiters.erase(commit_waiters.begin());
+  }
+
+  if (save_queued) {
+    save_queued = false;
+    if (version > committed)
+      _save();
+  }
+
+  finish_contexts(g_ceph_context, ls);
 }
 
 
@@ -805,6 +837,24 @@ size_t Session::get_request_count()
   return result;
 }
 
+/**
+ * How many preallocated inos we want this client to hold: the configured
+ * floor, grown to cover its recent create rate (create_heat counts roughly
+ * the last seven seconds of creates) so that a create storm refills, and
+ * journals a refill, only every few seconds rather than every few hundred
+ * creates.
+ */
+int Session::get_prealloc_target(utime_t now)
+{
+  int target = g_conf->mds_client_prealloc_inos;
+  int max = g_conf->mds_client_prealloc_inos_max;
+  if (max > target) {
+    int heat = (int)create_heat.get(now);
+    target = MIN(max, MAX(target, heat));
+  }
+  return target;
+}
+
 /**
  * Capped in response to a CEPH_MSG_CLIENT_CAPRELEASE message,
  * with n_caps equal to the number of caps that were released
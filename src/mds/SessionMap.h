@@ -146,6 +146,8 @@ public:
   size_t get_request_count();
 
   interval_set<inodeno_t> pending_prealloc_inos; // journaling prealloc, will be added to prealloc_inos
+  DecayCounter create_heat; // recently created inodes, sizes prealloc_inos
+  int get_prealloc_target(utime_t now);
 
   void notify_cap_release(size_t n_caps);
   void notify_recall_sent(const size_t new_limit);
@@ -205,6 +207,7 @@ private:
 
 public:
   xlist<Capability*> caps;     // inodes with caps; front=most recently used
+  xlist<Capability*> revoking_caps; // caps with a revoke in flight; front=oldest
   xlist<ClientLease*> leases;  // metadata leases to clients
   utime_t last_cap_renew;
 
@@ -228,6 +231,9 @@ public:
   void add_cap(Capability *cap) {
     caps.push_back(&cap->item_session_caps);
   }
+  void add_revoking_cap(Capability *cap) {
+    revoking_caps.push_back(&cap->item_client_revoking_caps);
+  }
   void touch_lease(ClientLease *r) {
     leases.push_back(&r->item_session_lease);
   }
@@ -324,6 +330,7 @@ public:
     auth_caps(g_ceph_context),
     connection(NULL), item_session_list(this),
     requests(0),  // member_offset passed to front() manually
+    create_heat(ceph_clock_now(), DecayRate(5.0)),
     cap_push_seq(0),
     lease_seq(0),
     completed_requests_dirty(false),
@@ -617,6 +624,10 @@ protected:
   std::set<entity_name_t> dirty_sessions;
   std::set<entity_name_t> null_sessions;
   bool loaded_legacy;
+  // A save was requested while another was in flight; it is issued, for
+  // whatever version is current then, once the in-flight one completes.
+  bool save_queued = false;
+  void _save();
   void _mark_dirty(Session *session);
 public:
 
@@ -649,7 +649,7 @@ void dirfrag_load_vec_t::generate_test_instances(list<dirfrag_load_vec_t*>& ls)
  * mds_load_t
  */
 void mds_load_t::encode(bufferlist &bl) const {
-  ENCODE_START(2, 2, bl);
+  ENCODE_START(3, 2, bl);
   ::encode(auth, bl);
   ::encode(all, bl);
   ::encode(pot_auth, bl);
@@ -658,11 +658,12 @@ void mds_load_t::encode(bufferlist &bl) const {
   ::encode(cache_hit_rate, bl);
   ::encode(queue_len, bl);
   ::encode(cpu_load_avg, bl);
+  ::encode(cpu_busiest_thread, bl);
   ENCODE_FINISH(bl);
 }
 
 void mds_load_t::decode(const utime_t &t, bufferlist::iterator &bl) {
-  DECODE_START_LEGACY_COMPAT_LEN(2, 2, 2, bl);
+  DECODE_START_LEGACY_COMPAT_LEN(3, 2, 2, bl);
   ::decode(auth, t, bl);
   ::decode(all, t, bl);
   ::decode(pot_auth, bl);
@@ -671,6 +672,8 @@ void mds_load_t::decode(const utime_t &t, bufferlist::iterator &bl) {
   ::decode(cache_hit_rate, bl);
   ::decode(queue_len, bl);
   ::decode(cpu_load_avg, bl);
+  if (struct_v >= 3)
+    ::decode(cpu_busiest_thread, bl);
   DECODE_FINISH(bl);
 }
 
@@ -680,6 +683,7 @@ void mds_load_t::dump(Formatter *f) const
   f->dump_float("cache hit rate", cache_hit_rate);
   f->dump_float("queue length", queue_len);
   f->dump_float("cpu load", cpu_load_avg);
+  f->dump_float("busiest thread cpu", cpu_busiest_thread);
   f->open_object_section("auth dirfrag");
   auth.dump(f);
   f->close_section();
@@ -694,6 +698,47 @@ void mds_load_t::generate_test_instances(list<mds_load_t*>& ls)
   ls.push_back(new mds_load_t(sample));
 }
 
+/*
+ * subtree_summary_t
+ */
+void subtree_summary_t::encode(bufferlist& bl) const
+{
+  ENCODE_START(1, 1, bl);
+  ::encode(dirfrag, bl);
+  ::encode(load, bl);
+  ::encode(size, bl);
+  ::encode(flags, bl);
+  ENCODE_FINISH(bl);
+}
+
+void subtree_summary_t::decode(bufferlist::iterator& bl)
+{
+  DECODE_START(1, bl);
+  ::decode(dirfrag, bl);
+  ::decode(load, bl);
+  ::decode(size, bl);
+  ::decode(flags, bl);
+  DECODE_FINISH(bl);
+}
+
+void subtree_summary_t::dump(Formatter *f) const
+{
+  f->dump_stream("dirfrag") << dirfrag;
+  f->dump_float("load", load);
+  f->dump_unsigned("size", size);
+  f->dump_unsigned("flags", flags);
+}
+
+void subtree_summary_t::generate_test_instances(list<subtree_summary_t*>& ls)
+{
+  ls.push_back(new subtree_summary_t);
+  ls.push_back(new subtree_summary_t);
+  ls.back()->dirfrag = dirfrag_t(0x10000000000ull, frag_t());
+  ls.back()->load = 12.5;
+  ls.back()->size = 1024;
+  ls.back()->flags = subtree_summary_t::FLAG_IMPORTED;
+}
+
 /*
  * cap_reconnect_t
  */
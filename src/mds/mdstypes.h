@@ -1564,7 +1564,8 @@ struct mds_load_t {
   double cache_hit_rate = 0.0;
   double queue_len = 0.0;
 
-  double cpu_load_avg = 0.0;
+  double cpu_load_avg = 0.0;        // cores used by this daemon
+  double cpu_busiest_thread = 0.0;  // share of a core used by its busiest thread
 
   explicit mds_load_t(const utime_t &t) : auth(t), all(t) {}
   // mostly for the dencoder infrastructure
@@ -1598,9 +1599,38 @@ inline std::ostream& operator<<( std::ostream& out, mds_load_t& load )
              << ", hr " << load.cache_hit_rate
              << ", qlen " << load.queue_len
 	     << ", cpu " << load.cpu_load_avg
+	     << "/" << load.cpu_busiest_thread
              << ">";
 }
 
+/*
+ * One of a rank's hottest auth subtrees, as advertised in MHeartbeat so
+ * that rank 0 can pick concrete dirfrags and importers.
+ */
+struct subtree_summary_t {
+  enum {
+    FLAG_PINNED = 1,    // export pinned; the balancer won't move it
+    FLAG_IMPORTED = 2,  // imported from another rank
+  };
+
+  dirfrag_t dirfrag;
+  float load = 0.0;
+  __u32 size = 0;       // auth dentries nested below
+  __u8 flags = 0;
+
+  void encode(bufferlist& bl) const;
+  void decode(bufferlist::iterator& bl);
+  void dump(Formatter *f) const;
+  static void generate_test_instances(list<subtree_summary_t*>& ls);
+};
+WRITE_CLASS_ENCODER(subtree_summary_t)
+
+inline std::ostream& operator<<(std::ostream& out, const subtree_summary_t& s)
+{
+  return out << "subtree(" << s.dirfrag << " load " << s.load
+	     << " size " << s.size << " flags " << (int)s.flags << ")";
+}
+
 class load_spread_t {
 public:
   static const int MAX = 4;
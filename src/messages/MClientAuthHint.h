@@ -0,0 +1,54 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*- 
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software 
+ * Foundation.  See file COPYING.
+ * 
+ */
+
+#ifndef CEPH_MCLIENTAUTHHINT_H
+#define CEPH_MCLIENTAUTHHINT_H
+
+#include "msg/Message.h"
+
+/*
+ * Sent by an MDS that just imported a subtree to the clients holding caps
+ * in it: these dirfrags are now served by 'auth', so requests for names
+ * in them can skip the forward from the old authority.
+ */
+struct MClientAuthHint : public Message {
+  mds_rank_t auth;
+  vector<dirfrag_t> dirfrags;
+
+  MClientAuthHint() :
+    Message(CEPH_MSG_CLIENT_AUTH_HINT),
+    auth(MDS_RANK_NONE) {}
+  explicit MClientAuthHint(mds_rank_t a) :
+    Message(CEPH_MSG_CLIENT_AUTH_HINT),
+    auth(a) {}
+private:
+  ~MClientAuthHint() override {}
+
+public:
+  const char *get_type_name() const override { return "client_auth_hint"; }
+  void print(ostream& out) const override {
+    out << "client_auth_hint(mds." << auth << " " << dirfrags.size()
+	<< " dirfrags)";
+  }
+
+  void encode_payload(uint64_t features) override {
+    ::encode(auth, payload);
+    ::encode(dirfrags, payload);
+  }
+  void decode_payload() override {
+    bufferlist::iterator p = payload.begin();
+    ::decode(auth, p);
+    ::decode(dirfrags, p);
+  }
+};
+
+#endif
@@ -20,10 +20,19 @@
 #include "msg/Message.h"
 
 class MHeartbeat : public Message {
+  static const int HEAD_VERSION = 2;
+  static const int COMPAT_VERSION = 1;
+
   mds_load_t load;
   __s32        beat;
   map<mds_rank_t, float> import_map;
 
+  // hottest auth subtrees, as a delta against the set sent with beat
+  // summary_base, or the full set if summary_base is -1
+  __s32 summary_base = -1;
+  vector<subtree_summary_t> subtrees;  // new or changed
+  vector<dirfrag_t> subtrees_gone;
+
  public:
   mds_load_t& get_load() { return load; }
   int get_beat() { return beat; }
@@ -32,10 +41,21 @@ class MHeartbeat : public Message {
     return import_map;
   }
 
+  int get_summary_base() const { return summary_base; }
+  vector<subtree_summary_t>& get_subtrees() { return subtrees; }
+  vector<dirfrag_t>& get_subtrees_gone() { return subtrees_gone; }
+  void set_subtree_summary(int base, const vector<subtree_summary_t>& changed,
+			   const vector<dirfrag_t>& gone) {
+    summary_base = base;
+    subtrees = changed;
+    subtrees_gone = gone;
+  }
+
   MHeartbeat()
-    : Message(MSG_MDS_HEARTBEAT), load(utime_t()) { }
+    : Message(MSG_MDS_HEARTBEAT, HEAD_VERSION, COMPAT_VERSION),
+      load(utime_t()) { }
   MHeartbeat(mds_load_t& load, int beat)
-    : Message(MSG_MDS_HEARTBEAT),
+    : Message(MSG_MDS_HEARTBEAT, HEAD_VERSION, COMPAT_VERSION),
       load(load) {
     this->beat = beat;
   }
@@ -49,6 +69,9 @@ public:
     ::encode(load, payload);
     ::encode(beat, payload);
     ::encode(import_map, payload);
+    ::encode(summary_base, payload);
+    ::encode(subtrees, payload);
+    ::encode(subtrees_gone, payload);
   }
   void decode_payload() override {
     bufferlist::iterator p = payload.begin();
@@ -56,6 +79,11 @@ public:
     ::decode(load, now, p);
     ::decode(beat, p);
     ::decode(import_map, p);
+    if (header.version >= 2) {
+      ::decode(summary_base, p);
+      ::decode(subtrees, p);
+      ::decode(subtrees_gone, p);
+    }
   }
 
 };
@@ -19,7 +19,6 @@ class MIFBeat : public Message
     vector<migration_decision_t> my_decision;
     //vector<mds_rank_t> target_import_mds_list;
     //vector<__u32> target_export_load_list;
-    map<mds_rank_t, double> decision_map;
 
 public:
     mds_load_t& get_load() { return load; }
@@ -59,9 +58,10 @@ public:
   const char *get_type_name() const override { return "IFB"; }
 
   void encode_payload(uint64_t features) override {
+    // on the wire only the export percent per importer is carried
+    map<mds_rank_t, double> decision_map;
     for (vector<migration_decision_t>::iterator it = my_decision.begin();it!=my_decision.end();it++){
       decision_map[(*it).target_import_mds]=(*it).target_export_percent;
-      decision_map[(*it).target_import_mds]=(*it).target_export_percent;
     }
 
     ::encode(load, payload);
@@ -76,7 +76,9 @@ public:
     ::decode(load, now, p);
     ::decode(beat, p);
     ::decode(IFvaule, p);
+    map<mds_rank_t, double> decision_map;
     ::decode(decision_map, p);
+    my_decision.clear();
     for(map<mds_rank_t, double>::iterator it = decision_map.begin(); it != decision_map.end();++it)
     {
       migration_decision_t temp_decision = {it->first,it->second,it->second};
@@ -117,6 +117,7 @@ using namespace std;
 #include "messages/MClientLease.h"
 #include "messages/MClientSnap.h"
 #include "messages/MClientQuota.h"
+#include "messages/MClientAuthHint.h"
 
 #include "messages/MMDSSlaveRequest.h"
 
@@ -619,6 +620,9 @@ Message *decode_message(CephContext *cct, int crcflags,
   case CEPH_MSG_CLIENT_QUOTA:
     m = new MClientQuota;
     break;
+  case CEPH_MSG_CLIENT_AUTH_HINT:
+    m = new MClientAuthHint;
+    break;
 
     // mds
   case MSG_MDS_SLAVE_REQUEST:
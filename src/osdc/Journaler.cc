@@ -80,6 +80,21 @@ void Journaler::set_layout(file_layout_t const *l)
     _set_layout(l);
 }
 
+/*
+ * Override journaler_prefetch_periods, e.g. to read further ahead while
+ * replaying.  Reads are issued per object, so a larger window means more
+ * journal objects in flight at once.
+ */
+void Journaler::set_prefetch_periods(uint64_t periods)
+{
+  lock_guard l(lock);
+  if (periods < 2)
+    periods = 2;  // we need at least 2 periods to make progress.
+  fetch_len = layout.get_period() * periods;
+  ldout(cct, 10) << "set_prefetch_periods " << periods
+		 << ", fetch_len " << fetch_len << dendl;
+}
+
 void Journaler::_set_layout(file_layout_t const *l)
 {
   layout = *l;
@@ -465,6 +465,7 @@ public:
   void set_layout(file_layout_t const *l);
   void set_readonly();
   void set_writeable();
+  void set_prefetch_periods(uint64_t periods);
   void set_write_pos(uint64_t p) {
     lock_guard l(lock);
     prezeroing_pos = prezero_pos = write_pos = flush_pos = safe_pos = next_safe_pos = p;
@@ -1220,7 +1220,8 @@ void ObjectCacher::bh_write_commit(int64_t poolid, sobject_t oid,
     finish_contexts(cct, ls, r);
 }
 
-void ObjectCacher::flush(ZTracer::Trace *trace, loff_t amount)
+void ObjectCacher::flush(ZTracer::Trace *trace, loff_t amount,
+			 int *max_count)
 {
   assert(trace != nullptr);
   assert(lock.is_locked());
@@ -1236,16 +1237,20 @@ void ObjectCacher::flush(ZTracer::Trace *trace, loff_t amount)
    */
   int64_t left = amount;
   while (amount == 0 || left > 0) {
+    if (max_count && *max_count <= 0)
+      break;
     BufferHead *bh = static_cast<BufferHead*>(
       bh_lru_dirty.lru_get_next_expire());
     if (!bh) break;
     if (bh->last_write > cutoff) break;
 
     if (scattered_write) {
-      bh_write_adjacencies(bh, cutoff, amount > 0 ? &left : NULL, NULL);
+      bh_write_adjacencies(bh, cutoff, amount > 0 ? &left : NULL, max_count);
     } else {
       left -= bh->length();
       bh_write(bh, *trace);
+      if (max_count)
+	--*max_count;
     }
   }
 }
@@ -1896,18 +1901,22 @@ void ObjectCacher::flusher_entry()
       trace.event("start");
     }
 
+    // the lock is usually the user's big lock (client_lock for
+    // libcephfs), so start writeback on at most MAX_FLUSH_UNDER_LOCK
+    // bhs per hold, in either case below, and let readers and writers
+    // in between batches.
+    int max = MAX_FLUSH_UNDER_LOCK;
     if (actual > 0 && (uint64_t) actual > target_dirty) {
       // flush some dirty pages
       ldout(cct, 10) << "flusher " << get_stat_dirty() << " dirty + "
 		     << get_stat_dirty_waiting() << " dirty_waiting > target "
 		     << target_dirty << ", flushing some dirty bhs" << dendl;
-      flush(&trace, actual - target_dirty);
+      flush(&trace, actual - target_dirty, &max);
     } else {
       // check tail of lru for old dirty items
       ceph::real_time cutoff = ceph::real_clock::now();
       cutoff -= max_dirty_age;
       BufferHead *bh = 0;
-      int max = MAX_FLUSH_UNDER_LOCK;
       while ((bh = static_cast<BufferHead*>(bh_lru_dirty.
 					    lru_get_next_expire())) != 0 &&
 	     bh->last_write <= cutoff &&
@@ -1920,13 +1929,13 @@ void ObjectCacher::flusher_entry()
 	  --max;
 	}
       }
-      if (!max) {
-	// back off the lock to avoid starving other threads
-        trace.event("backoff");
-	lock.Unlock();
-	lock.Lock();
-	continue;
-      }
+    }
+    if (max <= 0) {
+      // back off the lock to avoid starving other threads
+      trace.event("backoff");
+      lock.Unlock();
+      lock.Lock();
+      continue;
     }
 
     trace.event("finish");
@@ -201,6 +201,7 @@ TYPE(mds_table_pending_t)
 TYPE(inode_load_vec_t)
 TYPE(dirfrag_load_vec_t)
 TYPE(mds_load_t)
+TYPE(subtree_summary_t)
 TYPE(cap_reconnect_t)
 TYPE(inode_backtrace_t)
 TYPE(inode_backpointer_t)
@@ -0,0 +1,372 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+/*
+ * mdtest-style metadata benchmark through libcephfs.
+ *
+ * Every client is its own libcephfs mount (and so its own MDS session)
+ * driven by one thread.  The phases run in order, all clients in
+ * lockstep, and the results go to stdout as JSON: throughput, latency
+ * percentiles and how the requests of each phase spread over the MDS
+ * ranks.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <thread>
+
+#include <fcntl.h>
+
+#include "include/cephfs/libcephfs.h"
+
+#include "global/global_init.h"
+
+#include "common/ceph_argparse.h"
+#include "common/debug.h"
+#include "common/errno.h"
+#include "common/Formatter.h"
+#include "include/str_list.h"
+
+#define dout_context g_ceph_context
+#define dout_subsys ceph_subsys_client
+
+#define MAX_RANKS 256
+
+static void usage()
+{
+  derr << "usage: ceph_mds_bench [flags]\n"
+      "	 --clients\n"
+      "	       number of libcephfs mounts, one thread each (default 1)\n"
+      "	 --files\n"
+      "	       files per client, or in total with --shared (default 1000)\n"
+      "	 --dirs\n"
+      "	       directories the files are spread over (default 1)\n"
+      "	 --shared\n"
+      "	       all clients work in the same directories\n"
+      "	 --phases\n"
+      "	       comma separated, from create,stat,readdir,unlink\n"
+      "	       (default: all, in that order)\n"
+      "	 --access scan|zipf\n"
+      "	       order of the stat phase (default scan)\n"
+      "	 --zipf-theta\n"
+      "	       skew of the zipf access (default 0.99)\n"
+      "	 --ops\n"
+      "	       stats per client in zipf mode (default: --files)\n"
+      "	 --root\n"
+      "	       directory to run in (default /mds_bench)\n" << dendl;
+  generic_client_usage();
+}
+
+struct Config {
+  int clients = 1;
+  int files = 1000;
+  int dirs = 1;
+  bool shared = false;
+  std::vector<std::string> phases = {"create", "stat", "readdir", "unlink"};
+  bool zipf = false;
+  double zipf_theta = 0.99;
+  int ops = 0;
+  std::string root = "/mds_bench";
+};
+
+struct ClientResult {
+  uint64_t ops = 0;
+  uint64_t errors = 0;
+  std::vector<double> lat;   // usec
+};
+
+static std::string dir_path(const Config &cfg, int client, int dir)
+{
+  std::ostringstream ss;
+  ss << cfg.root;
+  if (!cfg.shared)
+    ss << "/client." << client;
+  ss << "/dir." << dir;
+  return ss.str();
+}
+
+static std::string file_path(const Config &cfg, int client, int file)
+{
+  std::ostringstream ss;
+  ss << dir_path(cfg, client, file % cfg.dirs) << "/file." << file;
+  return ss.str();
+}
+
+// files this client creates and unlinks
+static std::vector<int> own_files(const Config &cfg, int client)
+{
+  std::vector<int> v;
+  for (int i = 0; i < cfg.files; i++) {
+    if (!cfg.shared || i % cfg.clients == client)
+      v.push_back(i);
+  }
+  return v;
+}
+
+class ZipfGenerator {
+  std::vector<double> cdf;
+public:
+  ZipfGenerator(int n, double theta) : cdf(n) {
+    double sum = 0;
+    for (int i = 0; i < n; i++) {
+      sum += 1.0 / pow(i + 1, theta);
+      cdf[i] = sum;
+    }
+    for (auto &c : cdf)
+      c /= sum;
+  }
+  template<class RNG>
+  int operator()(RNG &rng) {
+    double u = std::uniform_real_distribution<double>(0, 1)(rng);
+    return std::lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin();
+  }
+};
+
+template<class F>
+static void timed(ClientResult *res, F &&op)
+{
+  using namespace std::chrono;
+  auto t1 = steady_clock::now();
+  int r = op();
+  auto t2 = steady_clock::now();
+  res->ops++;
+  if (r < 0)
+    res->errors++;
+  res->lat.push_back(duration<double, std::micro>(t2 - t1).count());
+}
+
+static void run_phase(const Config &cfg, const std::string &phase,
+		      struct ceph_mount_info *cmount, int client,
+		      ClientResult *res)
+{
+  if (phase == "create") {
+    for (int i : own_files(cfg, client)) {
+      std::string p = file_path(cfg, client, i);
+      timed(res, [&]() {
+	  int fd = ceph_open(cmount, p.c_str(), O_CREAT|O_WRONLY, 0644);
+	  if (fd < 0)
+	    return fd;
+	  return ceph_close(cmount, fd);
+	});
+    }
+  } else if (phase == "stat") {
+    struct ceph_statx stx;
+    if (cfg.zipf) {
+      // the hot files are the same for every client
+      ZipfGenerator zipf(cfg.files, cfg.zipf_theta);
+      std::mt19937 rng(client);
+      int ops = cfg.ops ? cfg.ops : cfg.files;
+      for (int n = 0; n < ops; n++) {
+	std::string p = file_path(cfg, client, zipf(rng));
+	timed(res, [&]() {
+	    return ceph_statx(cmount, p.c_str(), &stx, CEPH_STATX_BASIC_STATS, 0);
+	  });
+      }
+    } else {
+      for (int i = 0; i < cfg.files; i++) {
+	std::string p = file_path(cfg, client, i);
+	timed(res, [&]() {
+	    return ceph_statx(cmount, p.c_str(), &stx, CEPH_STATX_BASIC_STATS, 0);
+	  });
+      }
+    }
+  } else if (phase == "readdir") {
+    for (int d = 0; d < cfg.dirs; d++) {
+      std::string p = dir_path(cfg, client, d);
+      timed(res, [&]() {
+	  struct ceph_dir_result *dirp;
+	  int r = ceph_opendir(cmount, p.c_str(), &dirp);
+	  if (r < 0)
+	    return r;
+	  struct dirent de;
+	  struct ceph_statx stx;
+	  while ((r = ceph_readdirplus_r(cmount, dirp, &de, &stx,
+					 CEPH_STATX_BASIC_STATS, 0, NULL)) > 0)
+	    ;
+	  ceph_closedir(cmount, dirp);
+	  return r;
+	});
+    }
+  } else if (phase == "unlink") {
+    for (int i : own_files(cfg, client)) {
+      std::string p = file_path(cfg, client, i);
+      timed(res, [&]() { return ceph_unlink(cmount, p.c_str()); });
+    }
+  }
+}
+
+static double percentile(const std::vector<double> &sorted, double p)
+{
+  if (sorted.empty())
+    return 0;
+  size_t i = std::min(sorted.size() - 1, (size_t)(p * sorted.size()));
+  return sorted[i];
+}
+
+int main(int argc, const char *argv[])
+{
+  Config cfg;
+
+  vector<const char*> args;
+  argv_to_vec(argc, argv, args);
+  env_to_vec(args);
+
+  auto cct = global_init(nullptr, args, CEPH_ENTITY_TYPE_CLIENT,
+			 CODE_ENVIRONMENT_UTILITY, 0);
+
+  std::string val;
+  vector<const char*>::iterator i = args.begin();
+  while (i != args.end()) {
+    if (ceph_argparse_double_dash(args, i))
+      break;
+
+    if (ceph_argparse_witharg(args, i, &val, "--clients", (char*)nullptr)) {
+      cfg.clients = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--files", (char*)nullptr)) {
+      cfg.files = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--dirs", (char*)nullptr)) {
+      cfg.dirs = atoi(val.c_str());
+    } else if (ceph_argparse_flag(args, i, "--shared", (char*)nullptr)) {
+      cfg.shared = true;
+    } else if (ceph_argparse_witharg(args, i, &val, "--phases", (char*)nullptr)) {
+      cfg.phases.clear();
+      get_str_vec(val, cfg.phases);
+    } else if (ceph_argparse_witharg(args, i, &val, "--access", (char*)nullptr)) {
+      if (val != "scan" && val != "zipf") {
+	derr << "unknown access pattern " << val << dendl;
+	usage();
+	return 1;
+      }
+      cfg.zipf = (val == "zipf");
+    } else if (ceph_argparse_witharg(args, i, &val, "--zipf-theta", (char*)nullptr)) {
+      cfg.zipf_theta = atof(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--ops", (char*)nullptr)) {
+      cfg.ops = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--root", (char*)nullptr)) {
+      cfg.root = val;
+    } else {
+      derr << "Error: can't understand argument: " << *i << "\n" << dendl;
+      usage();
+      return 1;
+    }
+  }
+  if (cfg.clients < 1 || cfg.files < 1 || cfg.dirs < 1) {
+    usage();
+    return 1;
+  }
+  for (const auto &phase : cfg.phases) {
+    if (phase != "create" && phase != "stat" &&
+	phase != "readdir" && phase != "unlink") {
+      derr << "unknown phase " << phase << dendl;
+      usage();
+      return 1;
+    }
+  }
+
+  common_init_finish(g_ceph_context);
+
+  // mount
+  std::vector<struct ceph_mount_info*> mounts(cfg.clients);
+  for (int c = 0; c < cfg.clients; c++) {
+    int r = ceph_create_with_context(&mounts[c], g_ceph_context);
+    if (r == 0)
+      r = ceph_mount(mounts[c], "/");
+    if (r < 0) {
+      derr << "client " << c << " failed to mount: " << cpp_strerror(r) << dendl;
+      return 1;
+    }
+  }
+
+  // namespace
+  ceph_mkdirs(mounts[0], cfg.root.c_str(), 0755);
+  for (int c = 0; c < (cfg.shared ? 1 : cfg.clients); c++) {
+    for (int d = 0; d < cfg.dirs; d++)
+      ceph_mkdirs(mounts[0], dir_path(cfg, c, d).c_str(), 0755);
+  }
+
+  JSONFormatter f(true);
+  f.open_object_section("mds_bench");
+  f.open_object_section("config");
+  f.dump_int("clients", cfg.clients);
+  f.dump_int("files", cfg.files);
+  f.dump_int("dirs", cfg.dirs);
+  f.dump_bool("shared", cfg.shared);
+  f.dump_string("access", cfg.zipf ? "zipf" : "scan");
+  if (cfg.zipf)
+    f.dump_float("zipf_theta", cfg.zipf_theta);
+  f.dump_string("root", cfg.root);
+  f.close_section();
+
+  f.open_array_section("phases");
+  for (const auto &phase : cfg.phases) {
+    dout(0) << "phase " << phase << dendl;
+
+    std::vector<uint64_t> before(cfg.clients * MAX_RANKS);
+    for (int c = 0; c < cfg.clients; c++)
+      ceph_get_mds_request_counts(mounts[c], &before[c * MAX_RANKS], MAX_RANKS);
+
+    std::vector<ClientResult> results(cfg.clients);
+    std::vector<std::thread> workers;
+    using namespace std::chrono;
+    auto t1 = steady_clock::now();
+    for (int c = 0; c < cfg.clients; c++)
+      workers.emplace_back(run_phase, std::ref(cfg), std::ref(phase),
+			   mounts[c], c, &results[c]);
+    for (auto &w : workers)
+      w.join();
+    double secs = duration<double>(steady_clock::now() - t1).count();
+
+    std::vector<uint64_t> per_rank(MAX_RANKS);
+    std::vector<uint64_t> after(MAX_RANKS);
+    for (int c = 0; c < cfg.clients; c++) {
+      ceph_get_mds_request_counts(mounts[c], &after[0], MAX_RANKS);
+      for (int r = 0; r < MAX_RANKS; r++)
+	per_rank[r] += after[r] - before[c * MAX_RANKS + r];
+    }
+
+    uint64_t ops = 0, errors = 0;
+    std::vector<double> lat;
+    for (auto &res : results) {
+      ops += res.ops;
+      errors += res.errors;
+      lat.insert(lat.end(), res.lat.begin(), res.lat.end());
+    }
+    std::sort(lat.begin(), lat.end());
+
+    f.open_object_section("phase");
+    f.dump_string("name", phase);
+    f.dump_unsigned("ops", ops);
+    f.dump_unsigned("errors", errors);
+    f.dump_float("seconds", secs);
+    f.dump_float("ops_per_sec", secs > 0 ? ops / secs : 0);
+    f.open_object_section("latency_us");
+    f.dump_float("min", lat.empty() ? 0 : lat.front());
+    f.dump_float("p50", percentile(lat, .5));
+    f.dump_float("p90", percentile(lat, .9));
+    f.dump_float("p99", percentile(lat, .99));
+    f.dump_float("p999", percentile(lat, .999));
+    f.dump_float("max", lat.empty() ? 0 : lat.back());
+    f.close_section();
+    f.open_object_section("mds_requests");
+    for (int r = 0; r < MAX_RANKS; r++) {
+      if (per_rank[r])
+	f.dump_unsigned(std::to_string(r).c_str(), per_rank[r]);
+    }
+    f.close_section();
+    f.close_section();
+  }
+  f.close_section();
+  f.close_section();
+  f.flush(std::cout);
+  std::cout << std::endl;
+
+  for (auto cmount : mounts) {
+    ceph_unmount(cmount);
+    ceph_release(cmount);
+  }
+  return 0;
+}